@@ -0,0 +1,116 @@
+#ifndef __LARLITECV_BENCH_BENCHUTILS_H__
+#define __LARLITECV_BENCH_BENCHUTILS_H__
+
+// Small helpers shared by the benchmark programs: timing, peak memory,
+// running a phase in its own process, and writing results as JSON lines.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+namespace larlitecv {
+namespace bench {
+
+  inline double now_seconds() {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+  }
+
+  /// one benchmark measurement. written as a single JSON object per line so results can be appended and diffed.
+  class Result {
+  public:
+    Result( std::string bench, std::string phase ) {
+      set( "bench", bench );
+      set( "phase", phase );
+    };
+    void set( const std::string& key, const std::string& value ) { fFields.push_back( key+"\": \""+value+"\"" ); };
+    void set( const std::string& key, double value ) {
+      std::stringstream ss;
+      ss << key << "\": " << value;
+      fFields.push_back( ss.str() );
+    };
+    std::string json() const {
+      std::string line = "{";
+      for ( size_t i=0; i<fFields.size(); i++ ) {
+	if ( i>0 ) line += ", ";
+	line += "\""+fFields[i];
+      }
+      return line+"}";
+    };
+  protected:
+    std::vector<std::string> fFields;
+  };
+
+  inline void report( const Result& result, const std::string& resultsfile ) {
+    std::cout << result.json() << std::endl;
+    if ( resultsfile=="" ) return;
+    std::ofstream out( resultsfile.c_str(), std::ios::app );
+    out << result.json() << "\n";
+  }
+
+  /// run phase in a forked child so that its peak memory is its own.
+  /// returns the values phase put into its map, plus "seconds" and "peak_rss_kb".
+  inline std::map<std::string,double> run_isolated( std::function< void( std::map<std::string,double>& ) > phase ) {
+    std::map<std::string,double> values;
+    int fds[2];
+    if ( pipe( fds )!=0 ) return values;
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if ( pid==0 ) {
+      close( fds[0] );
+      std::map<std::string,double> child_values;
+      double start = now_seconds();
+      phase( child_values );
+      child_values["seconds"] = now_seconds()-start;
+      std::stringstream ss;
+      for ( auto const& kv : child_values ) ss << kv.first << " " << kv.second << "\n";
+      std::string msg = ss.str();
+      ssize_t nwritten = write( fds[1], msg.data(), msg.size() );
+      (void)nwritten;
+      close( fds[1] );
+      std::cout.flush();
+      _exit( 0 );
+    }
+    close( fds[1] );
+    std::string msg;
+    char buf[4096];
+    ssize_t n;
+    while ( (n=read( fds[0], buf, sizeof(buf) ))>0 ) msg.append( buf, n );
+    close( fds[0] );
+
+    int status = 0;
+    struct rusage usage;
+    wait4( pid, &status, 0, &usage );
+    if ( !WIFEXITED(status) || WEXITSTATUS(status)!=0 ) {
+      std::cout << "[bench] phase failed" << std::endl;
+      return values;
+    }
+
+    std::stringstream ss( msg );
+    std::string key;
+    double value;
+    while ( ss >> key >> value ) values[key] = value;
+    values["peak_rss_kb"] = (double)usage.ru_maxrss;
+    return values;
+  }
+
+  inline double file_size_mb( const std::string& path ) {
+    std::ifstream f( path.c_str(), std::ios::binary | std::ios::ate );
+    if ( !f.good() ) return 0.;
+    return (double)f.tellg()/1.0e6;
+  }
+
+}
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __LARLITECV_BENCH_SYNTHETICDATA_H__
+#define __LARLITECV_BENCH_SYNTHETICDATA_H__
+
+// Generates a synthetic larlite + larcv dataset for the benchmarks.
+//
+// Files come in blocks: for each block there is one larlite "mcinfo" file (mctruth_generator_tree),
+// one larlite "opreco" file (opflash_opflash_tree) and one larcv "supera" file (image2d_tpc_tree and
+// partroi_tpc_tree), all holding the same (run, subrun, event) list, just like real production output.
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <sys/stat.h>
+
+#include "Base/PSet.h"
+
+// larlite
+#include "DataFormat/storage_manager.h"
+#include "DataFormat/mctruth.h"
+#include "DataFormat/opflash.h"
+
+// larcv
+#include "DataFormat/IOManager.h"
+#include "DataFormat/EventImage2D.h"
+#include "DataFormat/EventROI.h"
+
+#include "TLorentzVector.h"
+#include "TRandom3.h"
+
+namespace larlitecv {
+namespace bench {
+
+  struct DatasetSpec {
+    std::string datadir;
+    int nfiles;          ///< number of file blocks
+    int events_per_file;
+    int events_per_subrun;
+    int first_run;
+    int image_rows;
+    int image_cols;
+    int nplanes;
+
+    DatasetSpec( const larcv::PSet& cfg ) {
+      datadir           = cfg.get<std::string>( "DataDir", "bench_data" );
+      nfiles            = cfg.get<int>( "NumFiles", 20 );
+      events_per_file   = cfg.get<int>( "EventsPerFile", 50 );
+      events_per_subrun = cfg.get<int>( "EventsPerSubrun", 25 );
+      first_run         = cfg.get<int>( "FirstRun", 5000 );
+      image_rows        = cfg.get<int>( "ImageRows", 256 );
+      image_cols        = cfg.get<int>( "ImageCols", 256 );
+      nplanes           = cfg.get<int>( "NumPlanes", 3 );
+    }
+
+    std::string describe() const {
+      std::stringstream ss;
+      ss << nfiles << " " << events_per_file << " " << events_per_subrun << " " << first_run << " "
+	 << image_rows << " " << image_cols << " " << nplanes;
+      return ss.str();
+    }
+
+    std::string larlite_filelist() const { return datadir+"/larlite_files.txt"; };
+    std::string larcv_filelist()   const { return datadir+"/larcv_files.txt"; };
+    int nentries() const { return nfiles*events_per_file; };
+  };
+
+  inline std::string numbered( const std::string& dir, const std::string& stem, int ifile ) {
+    std::stringstream ss;
+    ss << dir << "/" << stem << "_" << ifile << ".root";
+    return ss.str();
+  }
+
+  /// event ievent of the dataset: consecutive events, a new subrun every events_per_subrun events
+  inline void synthetic_rse( const DatasetSpec& spec, int ievent, int& run, int& subrun, int& event ) {
+    int isubrun = ievent/spec.events_per_subrun;
+    run    = spec.first_run + isubrun/100;
+    subrun = isubrun%100;
+    event  = ievent;
+  }
+
+  inline void write_larlite_block( const DatasetSpec& spec, int ifile, TRandom3& rand ) {
+    larlite::storage_manager mcinfo( larlite::storage_manager::kWRITE );
+    mcinfo.set_out_filename( numbered( spec.datadir, "larlite_mcinfo", ifile ) );
+    mcinfo.open();
+    larlite::storage_manager opreco( larlite::storage_manager::kWRITE );
+    opreco.set_out_filename( numbered( spec.datadir, "larlite_opreco", ifile ) );
+    opreco.open();
+
+    for ( int i=0; i<spec.events_per_file; i++ ) {
+      int run, subrun, event;
+      synthetic_rse( spec, ifile*spec.events_per_file+i, run, subrun, event );
+
+      // a muon-neutrino CC interaction somewhere around the TPC
+      larlite::event_mctruth* ev_mctruth = (larlite::event_mctruth*)mcinfo.get_data( larlite::data::kMCTruth, "generator" );
+      larlite::mctruth truth;
+      double enu = rand.Uniform( 0.1, 2.0 );
+      TLorentzVector pos( rand.Uniform(-10.,280.), rand.Uniform(-130.,130.), rand.Uniform(-10.,1050.), 0. );
+      larlite::mcpart nu( 0, 14, "primary", -1, 0., 0 );
+      nu.AddTrajectory( pos, TLorentzVector( 0., 0., enu, enu ) );
+      larlite::mcpart mu( 1, 13, "primary", 0, 0.1057, 1 );
+      mu.AddTrajectory( pos, TLorentzVector( 0., 0., 0.8*enu, 0.8*enu ) );
+      truth.Add( nu );
+      truth.Add( mu );
+      truth.SetNeutrino( rand.Integer(2), 0, 1000+rand.Integer(4), 18040, 2112, 0, 1., 0.5, 0.5, 0.2 );
+      ev_mctruth->push_back( truth );
+      mcinfo.set_id( run, subrun, event );
+      mcinfo.next_event();
+
+      larlite::event_opflash* ev_opflash = (larlite::event_opflash*)opreco.get_data( larlite::data::kOpFlash, "opflash" );
+      ev_opflash->resize( 1+rand.Integer(5) );
+      opreco.set_id( run, subrun, event );
+      opreco.next_event();
+    }
+    mcinfo.close();
+    opreco.close();
+  }
+
+  inline void write_larcv_block( const DatasetSpec& spec, int ifile, TRandom3& rand ) {
+    larcv::IOManager io( larcv::IOManager::kWRITE );
+    io.set_out_file( numbered( spec.datadir, "supera", ifile ) );
+    io.initialize();
+
+    for ( int i=0; i<spec.events_per_file; i++ ) {
+      int run, subrun, event;
+      synthetic_rse( spec, ifile*spec.events_per_file+i, run, subrun, event );
+
+      larcv::EventImage2D* ev_img = (larcv::EventImage2D*)io.get_data( larcv::kProductImage2D, "tpc" );
+      for ( int iplane=0; iplane<spec.nplanes; iplane++ ) {
+	larcv::ImageMeta meta( spec.image_cols, spec.image_rows, spec.image_rows, spec.image_cols, 0., spec.image_rows, (larcv::PlaneID_t)iplane );
+	larcv::Image2D img( meta );
+	// sparse "tracks": most pixels stay zero, like real wire images
+	for ( int ihit=0; ihit<spec.image_cols; ihit++ )
+	  img.set_pixel( rand.Integer( spec.image_rows ), rand.Integer( spec.image_cols ), rand.Uniform( 10., 200. ) );
+	ev_img->Emplace( std::move(img) );
+      }
+      larcv::EventROI* ev_roi = (larcv::EventROI*)io.get_data( larcv::kProductROI, "tpc" );
+      ev_roi->Append( larcv::ROI( larcv::kROIBNB ) );
+
+      io.set_id( run, subrun, event );
+      io.save_entry();
+    }
+    io.finalize();
+  }
+
+  /// make the dataset (unless one with the same spec is already in datadir) and its filelists
+  inline void make_dataset( const DatasetSpec& spec, bool regenerate=false ) {
+    std::string stampfile = spec.datadir+"/dataset.txt";
+    if ( !regenerate ) {
+      std::ifstream stamp( stampfile.c_str() );
+      std::string existing;
+      if ( stamp.good() && std::getline( stamp, existing ) && existing==spec.describe() ) {
+	std::cout << "[bench] reusing dataset in " << spec.datadir << std::endl;
+	return;
+      }
+    }
+
+    std::cout << "[bench] generating " << spec.nfiles << " file blocks x " << spec.events_per_file << " events in " << spec.datadir << std::endl;
+    mkdir( spec.datadir.c_str(), 0755 );
+    TRandom3 rand( 12345 );
+    std::ofstream larlite_list( spec.larlite_filelist().c_str() );
+    std::ofstream larcv_list( spec.larcv_filelist().c_str() );
+    for ( int ifile=0; ifile<spec.nfiles; ifile++ ) {
+      write_larlite_block( spec, ifile, rand );
+      write_larcv_block( spec, ifile, rand );
+      larlite_list << numbered( spec.datadir, "larlite_mcinfo", ifile ) << "\n"
+		   << numbered( spec.datadir, "larlite_opreco", ifile ) << "\n";
+      larcv_list << numbered( spec.datadir, "supera", ifile ) << "\n";
+    }
+    std::ofstream stamp( stampfile.c_str() );
+    stamp << spec.describe() << "\n";
+  }
+
+}
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+// config
+#include "Base/PSet.h"
+#include "Base/LArCVBaseUtilFunc.h"
+#include "Base/DataCoordinator.h"
+#include "Base/PipelinedEventLoop.h"
+
+// larlite data
+#include "DataFormat/mctruth.h"
+#include "DataFormat/opflash.h"
+
+// larcv data
+#include "DataFormat/EventImage2D.h"
+#include "DataFormat/EventROI.h"
+
+#include "BenchUtils.h"
+#include "SyntheticData.h"
+
+// End-to-end event-loop throughput benchmark, modeled on app/Example and app/SelectionExample.
+//
+// Workloads, each through a DataCoordinator over the synthetic dataset:
+//   read        : goto_entry + get the larlite mctruth/opflash and larcv image2d/partroi products
+//   select      : read + the SelectionExample neutrino cuts
+//   select_save : select + save_entry for passing events (IOMode 2)
+//   select_save_pipelined : select_save through a PipelinedEventLoop, with the stall time of each stage
+// For each workload events/s and MB/s (input file bytes per second) are reported.
+//
+// If BaselineFile exists, the program exits with status 1 when a workload's events/s falls more than
+// Tolerance (fraction) below the baseline. With UpdateBaseline: true the baseline is rewritten instead.
+//
+//   ./bench_eventloop [bench.cfg]
+
+static bool passes_selection( const larlite::mcnu& neutrino ) {
+  // same cuts as app/SelectionExample with its default configuration
+  bool modefound    = ( neutrino.InteractionType()==1001 );
+  bool currentfound = ( neutrino.CCNC()==0 );
+  double enu = neutrino.Nu().Momentum(0).E();
+  bool withinenergy = ( enu>0.200 && enu<0.750 );
+  const TLorentzVector& nu_pos = neutrino.Nu().Position();
+  bool withinTPC = ( nu_pos.X()>-1.0 && nu_pos.X()<270.0 && nu_pos.Y()>-118.0 && nu_pos.Y()<118.0 && nu_pos.Z()>0 && nu_pos.Z()<1037.0 );
+  return modefound & currentfound & withinenergy & withinTPC;
+}
+
+static double filelist_mb( const std::string& filelist ) {
+  double mb = 0.;
+  std::ifstream infile( filelist.c_str() );
+  std::string line;
+  while ( std::getline( infile, line ) ) {
+    if ( line!="" ) mb += larlitecv::bench::file_size_mb( line );
+  }
+  return mb;
+}
+
+static void run_pipelined( const std::string& cfgfile, const larlitecv::bench::DatasetSpec& spec, std::map<std::string,double>& out ) {
+
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( spec.larlite_filelist(), "larlite" );
+  dataco.set_filelist( spec.larcv_filelist(),   "larcv" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", "EventLoopSave" );
+
+  double start = larlitecv::bench::now_seconds();
+  larlitecv::PipelinedEventLoop loop( dataco, 4 );
+  loop.add_product( larlitecv::ProductLabel::larlite_product( larlite::data::kMCTruth, "generator" ) );
+  loop.add_product( larlitecv::ProductLabel::larlite_product( larlite::data::kOpFlash, "opflash" ) );
+  loop.add_product( larlitecv::ProductLabel::larcv_product( larcv::kProductImage2D, "tpc" ) );
+  loop.add_product( larlitecv::ProductLabel::larcv_product( larcv::kProductROI, "tpc" ) );
+  loop.run( []( larlitecv::EventProducts& products ) {
+      larlite::event_mctruth* ev_mctruth = (larlite::event_mctruth*)products.get_larlite_data( larlite::data::kMCTruth, "generator" );
+      larcv::EventImage2D* ev_img = (larcv::EventImage2D*)products.get_larcv_data( larcv::kProductImage2D, "tpc" );
+      if ( ev_mctruth->empty() || ev_img->Image2DArray().empty() ) return false;
+      return passes_selection( ev_mctruth->at(0).GetNeutrino() );
+    } );
+  double elapsed = larlitecv::bench::now_seconds()-start;
+
+  const larlitecv::PipelinedEventLoop::Stats& stats = loop.stats();
+  double input_mb = filelist_mb( spec.larlite_filelist() ) + filelist_mb( spec.larcv_filelist() );
+  out["nentries"]       = stats.nentries;
+  out["npass"]          = stats.nsaved;
+  out["loop_seconds"]   = elapsed;
+  out["events_per_sec"] = ( elapsed>0 ) ? stats.nentries/elapsed : 0.;
+  out["input_mb"]       = input_mb;
+  out["mb_per_sec"]     = ( elapsed>0 ) ? input_mb/elapsed : 0.;
+  out["read_stall_seconds"]    = stats.read_stall;
+  out["process_stall_seconds"] = stats.process_stall;
+  out["write_stall_seconds"]   = stats.write_stall;
+  out["output_mb"] = larlitecv::bench::file_size_mb( dataco.get_outputfile("larlite") )
+    + larlitecv::bench::file_size_mb( dataco.get_outputfile("larcv") );
+}
+
+static void run_workload( const std::string& workload, const std::string& cfgfile, const larlitecv::bench::DatasetSpec& spec,
+			  std::map<std::string,double>& out ) {
+
+  bool select = ( workload!="read" );
+  bool save   = ( workload=="select_save" );
+
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( spec.larlite_filelist(), "larlite" );
+  dataco.set_filelist( spec.larcv_filelist(),   "larcv" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", save ? "EventLoopSave" : "EventLoopRead" );
+  dataco.initialize();
+
+  int nentries = dataco.get_nentries("larcv");
+  int npass = 0;
+  double start = larlitecv::bench::now_seconds();
+  for ( int ientry=0; ientry<nentries; ientry++ ) {
+    dataco.goto_entry( ientry, "larcv" );
+
+    larlite::event_mctruth* ev_mctruth = (larlite::event_mctruth*)dataco.get_larlite_data( larlite::data::kMCTruth, "generator" );
+    larlite::event_opflash* ev_opflash = (larlite::event_opflash*)dataco.get_larlite_data( larlite::data::kOpFlash, "opflash" );
+    larcv::EventImage2D* ev_img = (larcv::EventImage2D*)dataco.get_larcv_data( larcv::kProductImage2D, "tpc" );
+    larcv::EventROI* ev_roi     = (larcv::EventROI*)dataco.get_larcv_data( larcv::kProductROI, "tpc" );
+    if ( ev_mctruth->empty() || ev_img->Image2DArray().empty() ) continue;
+    (void)ev_opflash;
+    (void)ev_roi;
+
+    if ( !select ) continue;
+    bool passes = passes_selection( ev_mctruth->at(0).GetNeutrino() );
+    if ( passes ) npass++;
+    if ( passes && save ) dataco.save_entry();
+  }
+  dataco.finalize();
+  double elapsed = larlitecv::bench::now_seconds()-start;
+
+  double input_mb = filelist_mb( spec.larlite_filelist() ) + filelist_mb( spec.larcv_filelist() );
+  out["nentries"]       = nentries;
+  out["npass"]          = npass;
+  out["loop_seconds"]   = elapsed;
+  out["events_per_sec"] = ( elapsed>0 ) ? nentries/elapsed : 0.;
+  out["input_mb"]       = input_mb;
+  out["mb_per_sec"]     = ( elapsed>0 ) ? input_mb/elapsed : 0.;
+  if ( save ) {
+    double output_mb = larlitecv::bench::file_size_mb( dataco.get_outputfile("larlite") )
+      + larlitecv::bench::file_size_mb( dataco.get_outputfile("larcv") );
+    out["output_mb"] = output_mb;
+  }
+}
+
+static std::map<std::string,double> load_baseline( const std::string& baselinefile ) {
+  // one "workload events_per_sec" pair per line
+  std::map<std::string,double> baseline;
+  std::ifstream infile( baselinefile.c_str() );
+  std::string workload;
+  double rate;
+  while ( infile >> workload >> rate ) baseline[workload] = rate;
+  return baseline;
+}
+
+int main( int nargs, char** argv ) {
+
+  std::string cfgfile = ( nargs>1 ) ? argv[1] : "bench.cfg";
+  larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+  larcv::PSet bench_cfg = cfg.get<larcv::PSet>("BenchmarkConfig");
+
+  larlitecv::bench::DatasetSpec spec( bench_cfg );
+  larlitecv::bench::make_dataset( spec, bench_cfg.get<bool>( "Regenerate", false ) );
+
+  std::string resultsfile  = bench_cfg.get<std::string>( "ResultsFile", "bench_results.jsonl" );
+  std::string baselinefile = bench_cfg.get<std::string>( "BaselineFile", "bench_eventloop_baseline.txt" );
+  double tolerance         = bench_cfg.get<double>( "Tolerance", 0.10 );
+  bool update_baseline     = bench_cfg.get<bool>( "UpdateBaseline", false );
+  int repeat               = bench_cfg.get<int>( "Repeat", 3 );
+
+  std::map<std::string,double> baseline = load_baseline( baselinefile );
+  std::map<std::string,double> best;
+
+  std::string workloads[4] = { "read", "select", "select_save", "select_save_pipelined" };
+  for ( int irep=0; irep<repeat; irep++ ) {
+    for ( auto const& workload : workloads ) {
+      std::map<std::string,double> values = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	  if ( workload=="select_save_pipelined" ) run_pipelined( cfgfile, spec, out );
+	  else run_workload( workload, cfgfile, spec, out );
+	} );
+      larlitecv::bench::Result result( "eventloop", workload );
+      result.set( "repeat", irep );
+      for ( auto const& kv : values ) result.set( kv.first, kv.second );
+      larlitecv::bench::report( result, resultsfile );
+      // compare the best of the repeats, the least noisy number
+      if ( values["events_per_sec"]>best[workload] ) best[workload] = values["events_per_sec"];
+    }
+  }
+
+  if ( update_baseline ) {
+    std::ofstream out( baselinefile.c_str() );
+    for ( auto const& kv : best ) out << kv.first << " " << kv.second << "\n";
+    std::cout << "[bench] wrote baseline " << baselinefile << std::endl;
+    return 0;
+  }
+
+  bool regressed = false;
+  for ( auto const& kv : best ) {
+    auto iter = baseline.find( kv.first );
+    if ( iter==baseline.end() ) {
+      std::cout << "[bench] " << kv.first << ": " << kv.second << " events/s (no baseline)" << std::endl;
+      continue;
+    }
+    double ratio = kv.second/iter->second;
+    bool bad = ( ratio < 1.0-tolerance );
+    std::cout << "[bench] " << kv.first << ": " << kv.second << " events/s, baseline " << iter->second
+	      << " (" << ratio*100. << "%)" << ( bad ? "  REGRESSION" : "" ) << std::endl;
+    if ( bad ) regressed = true;
+  }
+
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+
+// config
+#include "Base/PSet.h"
+#include "Base/LArCVBaseUtilFunc.h"
+
+// larlitecv
+#include "Base/FileManager.h"
+#include "Base/LarliteFileManager.h"
+#include "Base/LarcvFileManager.h"
+
+#include "BenchUtils.h"
+#include "SyntheticData.h"
+
+// Index-build benchmark.
+//
+// Times LarliteFileManager and LarcvFileManager over a synthetic dataset:
+//   index_build : initialize() from scratch
+//   cache_save  : writing the index cache
+//   cache_load  : reading the index cache back into a fresh manager
+// Each phase runs in its own process so peak_rss_kb is that phase's own high-water mark.
+// Results are printed and appended as JSON lines to ResultsFile.
+//
+//   ./bench_index [bench.cfg]
+
+// exposes the cache functions the managers use internally
+template <class FMan>
+class CacheBench : public FMan {
+public:
+  CacheBench( std::string flist ) : FMan( flist, false ) {};
+  void save_cache() { this->cache_index( this->get_filelisthash() ); };
+  void load_cache() { this->load_from_cache( this->get_filelisthash() ); };
+};
+
+template <class FMan>
+void bench_filemanager( const std::string& ftype, const std::string& filelist, int repeat, const std::string& resultsfile ) {
+
+  for ( int irep=0; irep<repeat; irep++ ) {
+
+    std::map<std::string,double> build = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	CacheBench<FMan> fman( filelist );
+	double start = larlitecv::bench::now_seconds();
+	fman.initialize();
+	out["op_seconds"] = larlitecv::bench::now_seconds()-start;
+	out["nentries"]   = fman.nentries();
+	out["nfiles"]     = fman.get_final_filelist().size();
+      } );
+
+    std::map<std::string,double> save = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	CacheBench<FMan> fman( filelist );
+	fman.initialize();
+	double start = larlitecv::bench::now_seconds();
+	fman.save_cache();
+	out["op_seconds"] = larlitecv::bench::now_seconds()-start;
+	out["nentries"]   = fman.nentries();
+      } );
+
+    std::map<std::string,double> load = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	CacheBench<FMan> fman( filelist );
+	double start = larlitecv::bench::now_seconds();
+	fman.load_cache();
+	out["op_seconds"] = larlitecv::bench::now_seconds()-start;
+	out["nentries"]   = fman.nentries();
+      } );
+
+    std::string phases[3] = { "index_build", "cache_save", "cache_load" };
+    std::map<std::string,double>* values[3] = { &build, &save, &load };
+    for ( int iphase=0; iphase<3; iphase++ ) {
+      larlitecv::bench::Result result( "index", phases[iphase] );
+      result.set( "filetype", ftype );
+      result.set( "repeat", irep );
+      for ( auto const& kv : *values[iphase] ) result.set( kv.first, kv.second );
+      larlitecv::bench::report( result, resultsfile );
+    }
+  }
+}
+
+int main( int nargs, char** argv ) {
+
+  std::string cfgfile = ( nargs>1 ) ? argv[1] : "bench.cfg";
+  larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+  larcv::PSet bench_cfg = cfg.get<larcv::PSet>("BenchmarkConfig");
+
+  larlitecv::bench::DatasetSpec spec( bench_cfg );
+  larlitecv::bench::make_dataset( spec, bench_cfg.get<bool>( "Regenerate", false ) );
+
+  int repeat = bench_cfg.get<int>( "Repeat", 3 );
+  std::string resultsfile = bench_cfg.get<std::string>( "ResultsFile", "bench_results.jsonl" );
+
+  bench_filemanager<larlitecv::LarliteFileManager>( "larlite", spec.larlite_filelist(), repeat, resultsfile );
+  bench_filemanager<larlitecv::LarcvFileManager>( "larcv", spec.larcv_filelist(), repeat, resultsfile );
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+// config
+#include "Base/PSet.h"
+#include "Base/LArCVBaseUtilFunc.h"
+#include "Base/DataCoordinator.h"
+#include "Base/FileManager.h"
+
+#include "TRandom3.h"
+
+#include "BenchUtils.h"
+#include "SyntheticData.h"
+
+// Random-access navigation latency benchmark.
+//
+// Measures single-call latency of DataCoordinator::goto_entry and goto_event for
+//   sequential : 0,1,2,...
+//   strided    : every (EventsPerFile/2+1)th entry, so about every other call changes file
+//   random     : uniformly random entries
+// with larlite and larcv as the driver. Reports mean, p50, p99 and max in microseconds, and the
+// fraction of calls that moved to a different file block.
+//
+//   ./bench_navigation [bench.cfg]
+
+static std::vector<int> make_pattern( const std::string& pattern, int nentries, int nsamples, int stride ) {
+  std::vector<int> entries;
+  TRandom3 rand( 4242 );
+  for ( int i=0; i<nsamples; i++ ) {
+    if ( pattern=="sequential" )   entries.push_back( i%nentries );
+    else if ( pattern=="strided" ) entries.push_back( (int)( ((long)i*stride)%nentries ) );
+    else                           entries.push_back( (int)rand.Integer( nentries ) );
+  }
+  return entries;
+}
+
+static double percentile( const std::vector<double>& sorted, double p ) {
+  if ( sorted.empty() ) return 0.;
+  size_t idx = (size_t)( p*(sorted.size()-1) + 0.5 );
+  return sorted[idx];
+}
+
+static void run_pattern( const std::string& cfgfile, const larlitecv::bench::DatasetSpec& spec, const std::string& driver,
+			 const std::string& method, const std::string& pattern, int nsamples, std::map<std::string,double>& out ) {
+
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( spec.larlite_filelist(), "larlite" );
+  dataco.set_filelist( spec.larcv_filelist(),   "larcv" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", "EventLoopRead" );
+  dataco.initialize();
+
+  const larlitecv::FileManager* fman = dataco.get_filemanager( driver );
+  int nentries = dataco.get_nentries( driver );
+  std::vector<int> entries = make_pattern( pattern, nentries, nsamples, spec.events_per_file/2+1 );
+
+  std::vector<double> latencies;
+  latencies.reserve( entries.size() );
+  int last_block = -1;
+  int nswitches = 0;
+  for ( auto const& entry : entries ) {
+    int run, subrun, event;
+    fman->getRSE( entry, run, subrun, event );
+    int block = fman->getFileBlock( entry );
+    if ( last_block>=0 && block!=last_block ) nswitches++;
+    last_block = block;
+
+    double start = larlitecv::bench::now_seconds();
+    if ( method=="goto_entry" )
+      dataco.goto_entry( entry, driver );
+    else
+      dataco.goto_event( run, subrun, event, driver );
+    latencies.push_back( (larlitecv::bench::now_seconds()-start)*1.0e6 );
+  }
+  dataco.finalize();
+
+  double total = 0.;
+  for ( auto const& l : latencies ) total += l;
+  std::sort( latencies.begin(), latencies.end() );
+  out["nsamples"]          = latencies.size();
+  out["mean_us"]           = latencies.empty() ? 0. : total/latencies.size();
+  out["p50_us"]            = percentile( latencies, 0.50 );
+  out["p99_us"]            = percentile( latencies, 0.99 );
+  out["max_us"]            = latencies.empty() ? 0. : latencies.back();
+  out["cross_file_frac"]   = latencies.size()>1 ? (double)nswitches/(latencies.size()-1) : 0.;
+}
+
+int main( int nargs, char** argv ) {
+
+  std::string cfgfile = ( nargs>1 ) ? argv[1] : "bench.cfg";
+  larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+  larcv::PSet bench_cfg = cfg.get<larcv::PSet>("BenchmarkConfig");
+
+  larlitecv::bench::DatasetSpec spec( bench_cfg );
+  larlitecv::bench::make_dataset( spec, bench_cfg.get<bool>( "Regenerate", false ) );
+
+  std::string resultsfile = bench_cfg.get<std::string>( "ResultsFile", "bench_results.jsonl" );
+  int nsamples = bench_cfg.get<int>( "NavigationSamples", 1000 );
+
+  std::string drivers[2]  = { "larlite", "larcv" };
+  std::string methods[2]  = { "goto_entry", "goto_event" };
+  std::string patterns[3] = { "sequential", "strided", "random" };
+  for ( auto const& driver : drivers ) {
+    for ( auto const& method : methods ) {
+      for ( auto const& pattern : patterns ) {
+	std::map<std::string,double> values = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	    run_pattern( cfgfile, spec, driver, method, pattern, nsamples, out );
+	  } );
+	larlitecv::bench::Result result( "navigation", method );
+	result.set( "driver", driver );
+	result.set( "pattern", pattern );
+	for ( auto const& kv : values ) result.set( kv.first, kv.second );
+	larlitecv::bench::report( result, resultsfile );
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+// config
+#include "Base/PSet.h"
+#include "Base/LArCVBaseUtilFunc.h"
+#include "Base/DataCoordinator.h"
+#include "Base/FileManager.h"
+
+#include "BenchUtils.h"
+#include "SyntheticData.h"
+
+// Startup benchmark: time from an empty DataCoordinator to the first event, on a dataset
+// of many small files (StartupDataset in bench.cfg).
+//
+//   cold      : index cache off, every file is opened to build the index
+//   warm      : index loaded from .pylardcache (written once, untimed, before the phases)
+//   warm_lazy : warm, and only the first file block is opened for reading (set_lazy_open)
+//
+// Each phase runs in its own process. Reports init_seconds (initialize), first_event_seconds
+// (goto_entry(0)), seconds (both), peak_rss_kb and from_cache.
+//
+//   ./bench_startup [bench.cfg]
+
+static void run_startup( const std::string& cfgfile, const larlitecv::bench::DatasetSpec& spec,
+			 bool use_cache, bool lazy, std::map<std::string,double>& out ) {
+
+  double start = larlitecv::bench::now_seconds();
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( spec.larlite_filelist(), "larlite" );
+  dataco.set_filelist( spec.larcv_filelist(),   "larcv" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", "EventLoopRead" );
+  dataco.use_index_cache( use_cache );
+  dataco.set_lazy_open( lazy );
+  dataco.initialize();
+  double init_done = larlitecv::bench::now_seconds();
+
+  dataco.goto_entry( 0, "larcv" );
+  double first_done = larlitecv::bench::now_seconds();
+
+  out["init_seconds"]        = init_done-start;
+  out["first_event_seconds"] = first_done-init_done;
+  out["from_cache"]          = ( dataco.get_filemanager("larlite")->loaded_from_cache()
+				 && dataco.get_filemanager("larcv")->loaded_from_cache() ) ? 1. : 0.;
+  out["nentries"]            = (double)dataco.get_nentries( "larcv" );
+  dataco.finalize();
+}
+
+// build the index once with the cache on, so that the warm phases find it. not timed.
+static void write_index_cache( const std::string& cfgfile, const larlitecv::bench::DatasetSpec& spec ) {
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( spec.larlite_filelist(), "larlite" );
+  dataco.set_filelist( spec.larcv_filelist(),   "larcv" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", "EventLoopRead" );
+  dataco.use_index_cache( true );
+  dataco.initialize_index();
+}
+
+int main( int nargs, char** argv ) {
+
+  std::string cfgfile = ( nargs>1 ) ? argv[1] : "bench.cfg";
+  larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+  larcv::PSet bench_cfg = cfg.get<larcv::PSet>("BenchmarkConfig");
+  larcv::PSet startup_cfg = bench_cfg.get<larcv::PSet>("StartupDataset");
+
+  larlitecv::bench::DatasetSpec spec( startup_cfg );
+  larlitecv::bench::make_dataset( spec, bench_cfg.get<bool>( "Regenerate", false ) );
+
+  std::string resultsfile = bench_cfg.get<std::string>( "ResultsFile", "bench_results.jsonl" );
+  int repeat = bench_cfg.get<int>( "Repeat", 3 );
+
+  struct Phase { const char* name; bool use_cache; bool lazy; };
+  Phase phases[3] = { { "cold", false, false }, { "warm", true, false }, { "warm_lazy", true, true } };
+
+  larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+      (void)out;
+      write_index_cache( cfgfile, spec );
+    } );
+
+  for ( int irepeat=0; irepeat<repeat; irepeat++ ) {
+    for ( auto const& phase : phases ) {
+      std::map<std::string,double> values = larlitecv::bench::run_isolated( [&]( std::map<std::string,double>& out ) {
+	  run_startup( cfgfile, spec, phase.use_cache, phase.lazy, out );
+	} );
+      if ( phase.use_cache && values["from_cache"]!=1. ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " phase " << phase.name << " did not load the index from the cache" << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      larlitecv::bench::Result result( "startup", phase.name );
+      result.set( "nfiles", (double)spec.nfiles );
+      result.set( "repeat", (double)irepeat );
+      for ( auto const& kv : values ) result.set( kv.first, kv.second );
+      larlitecv::bench::report( result, resultsfile );
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <cmath>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "Base/PSet.h"
+#include "Base/LArCVBaseUtilFunc.h"
+#include "Base/DataCoordinator.h"
+#include "Base/EventMetadata.h"
+
+// larlite data
+#include "Base/DataFormatConstants.h"
+#include "DataFormat/mctruth.h"
+#include "DataFormat/mcnu.h"
+
+// Writes the neutrino scalars of every event of a larlite filelist into an event metadata sidecar.
+// Only the mctruth trees are read; no larcv file is opened.
+//
+//   make_nu_metadata [config]   (default: config.cfg)
+//
+// a job then selects on the sidecar before it opens anything, e.g.
+//   dataco.select_by_metadata( "nu_metadata.bin", { larlitecv::MetadataCut( "enu", 0.2, 0.75 ) } );
+//   while ( dataco.goto_next_listed() ) { ... }
+
+typedef larlitecv::EventMetadata::Extractor_t Extractor_t;
+
+// the neutrino of the current event. nullptr if there is none.
+const larlite::mcnu* get_neutrino( larlitecv::DataCoordinator& dataco, const std::string& producer ) {
+  larlite::event_mctruth* ev_mctruth = (larlite::event_mctruth*)dataco.get_larlite_data( larlite::data::kMCTruth, producer );
+  if ( ev_mctruth==nullptr || ev_mctruth->empty() ) return nullptr;
+  return &( ev_mctruth->at(0).GetNeutrino() );
+}
+
+std::map< std::string, Extractor_t > neutrino_extractors( const std::string& producer ) {
+  std::map< std::string, Extractor_t > extractors;
+  extractors["enu"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->Nu().Momentum(0).E() : NAN;
+  };
+  extractors["mode"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->InteractionType() : NAN;
+  };
+  extractors["ccnc"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->CCNC() : NAN;
+  };
+  extractors["vtx_x"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->Nu().Position().X() : NAN;
+  };
+  extractors["vtx_y"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->Nu().Position().Y() : NAN;
+  };
+  extractors["vtx_z"] = [producer]( larlitecv::DataCoordinator& dataco ) {
+    const larlite::mcnu* nu = get_neutrino( dataco, producer );
+    return nu ? (double)nu->Nu().Position().Z() : NAN;
+  };
+  return extractors;
+}
+
+int main( int nargs, char** argv ) {
+
+  std::string cfgfile = ( nargs>1 ) ? argv[1] : "config.cfg";
+  larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+  larcv::PSet meta_config = cfg.get<larcv::PSet>("NuMetadata");
+  std::string larlite_flist = meta_config.get<std::string>("LArLiteFilelist");
+  std::string producer      = meta_config.get<std::string>("InputMCTruthProducer");
+  std::string sidecar       = meta_config.get<std::string>("OutputSidecar");
+  std::vector<std::string> columns = meta_config.get<std::vector<std::string> >("Columns");
+
+  std::map< std::string, Extractor_t > available = neutrino_extractors( producer );
+  std::vector< std::pair< std::string, Extractor_t > > extractors;
+  for ( auto const& column : columns ) {
+    auto iter = available.find( column );
+    if ( iter==available.end() ) {
+      std::cout << "Unknown column '" << column << "'. Available:";
+      for ( auto const& avail : available ) std::cout << " " << avail.first;
+      std::cout << std::endl;
+      return 1;
+    }
+    extractors.push_back( *iter );
+  }
+
+  larlitecv::DataCoordinator dataco;
+  dataco.set_filelist( larlite_flist, "larlite" );
+  dataco.configure( cfgfile, "StorageManager", "IOManager", "NuMetadata" );
+  dataco.initialize();
+
+  larlitecv::EventMetadata metadata = larlitecv::EventMetadata::extract( dataco, "larlite", extractors );
+  dataco.finalize();
+
+  if ( !metadata.save( sidecar ) ) {
+    std::cout << "Could not write " << sidecar << std::endl;
+    return 1;
+  }
+  std::cout << "wrote " << metadata.size() << " events to " << sidecar << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+#include "Base/IndexDaemon.h"
+
+// Node-local index daemon.
+//
+//   larlitecv_indexd [socket path]        start serving (default: $LARLITECV_INDEXD_SOCKET or /tmp/larlitecv_indexd_<uid>.sock)
+//   larlitecv_indexd --stop [socket path] ask a running daemon to exit
+//
+// jobs pick up the daemon when LARLITECV_INDEXD_SOCKET is set in their environment
+// (or via DataCoordinator::set_index_daemon). Without a daemon they index in-process.
+
+int main( int nargs, char** argv ) {
+
+  bool stop = false;
+  std::string socketpath = larlitecv::IndexDaemon::default_socket();
+  for ( int iarg=1; iarg<nargs; iarg++ ) {
+    if ( strcmp( argv[iarg], "--stop" )==0 ) stop = true;
+    else socketpath = argv[iarg];
+  }
+
+  if ( stop ) {
+    larlitecv::IndexClient client( socketpath );
+    if ( !client.request_shutdown() ) {
+      std::cout << "Could not stop daemon at " << socketpath << ": " << client.last_error() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  try {
+    larlitecv::IndexDaemon daemon( socketpath );
+    daemon.serve();
+  }
+  catch ( std::exception& e ) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
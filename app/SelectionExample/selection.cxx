@@ -39,6 +39,8 @@ int main( int nargs, char** argv ) {
   std::vector<float> Enu_bounds_GeV = select_config.get<std::vector<float>>("EnuBoundsGeV");
   int start_entry = select_config.get<int>("StartEntry", 0);
   int max_entries = select_config.get<int>("MaxEntries",-1);
+  int shard_index = select_config.get<int>("ShardIndex",0);
+  int num_shards  = select_config.get<int>("NumShards",1);
 
   if ( Enu_bounds_GeV.size()!=2 ) {
     throw std::runtime_error("EnuBounds_GeV must have two values.");
@@ -67,6 +69,10 @@ int main( int nargs, char** argv ) {
 
   // configure
   dataco.configure( "config.cfg", "StorageManager", "IOManager", "SelectionConfigurationFile" );
+
+  // only index and open the files of our shard. entry numbers below are then within the shard.
+  if ( num_shards>1 )
+    dataco.set_shard( shard_index, num_shards, "larcv" );
   
   // initialize
   dataco.initialize();
@@ -0,0 +1,138 @@
+#include "AsyncNavigator.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include "TROOT.h"
+#endif
+
+namespace larlitecv {
+
+  AsyncNavigator::AsyncNavigator( DataCoordinator& source, int nbuffers )
+    : fSource(&source), fNextBuffer(0), fBusy(false), fStop(false)
+  {
+    if ( nbuffers<1 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " need at least one buffer, got " << nbuffers << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    // the buffers would all write the same output files
+    if ( source.get_outputfile("larlite")!="" || source.get_outputfile("larcv")!="" ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " AsyncNavigator only reads. configure the source with IOMode 0." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+    ROOT::EnableThreadSafety();
+#endif
+
+    source.initialize_index();
+    for ( int ibuffer=0; ibuffer<nbuffers; ibuffer++ ) {
+      DataCoordinator* buffer = new DataCoordinator;
+      buffer->share_index( source );
+      fBuffers.push_back( buffer );
+      fOpened.push_back( false );
+    }
+    fThread = std::thread( &AsyncNavigator::io_loop, this );
+  }
+
+  AsyncNavigator::~AsyncNavigator() {
+    {
+      std::lock_guard<std::mutex> guard( fMutex );
+      fStop = true;
+    }
+    fWake.notify_all();
+    fThread.join();
+    for ( size_t ibuffer=0; ibuffer<fBuffers.size(); ibuffer++ ) {
+      if ( fOpened[ibuffer] ) fBuffers[ibuffer]->finalize();
+      delete fBuffers[ibuffer];
+    }
+  }
+
+  AsyncNavigator::Result_t AsyncNavigator::submit( Move_t move, Callback_t done ) {
+    Request request;
+    request.move    = move;
+    request.promise = std::make_shared< std::promise<DataCoordinator*> >();
+    request.done    = done;
+    Result_t result = request.promise->get_future().share();
+    {
+      std::lock_guard<std::mutex> guard( fMutex );
+      request.ibuffer = fNextBuffer;
+      fNextBuffer = ( fNextBuffer+1 )%(int)fBuffers.size();
+      fRequests.push_back( request );
+    }
+    fWake.notify_one();
+    return result;
+  }
+
+  void AsyncNavigator::io_loop() {
+    while ( true ) {
+      Request request;
+      {
+	std::unique_lock<std::mutex> lock( fMutex );
+	fWake.wait( lock, [this]() { return fStop || !fRequests.empty(); } );
+	if ( fRequests.empty() ) return; // stopping, and nothing left to do
+	request = fRequests.front();
+	fRequests.pop_front();
+	fBusy = true;
+      }
+
+      DataCoordinator* buffer = fBuffers[request.ibuffer];
+      std::string error;
+      try {
+	if ( !fOpened[request.ibuffer] ) {
+	  buffer->initialize();
+	  fOpened[request.ibuffer] = true;
+	}
+	request.move( *buffer );
+	request.promise->set_value( buffer );
+      }
+      catch ( std::exception& e ) {
+	error = e.what();
+	request.promise->set_exception( std::current_exception() );
+      }
+      if ( request.done ) {
+	try {
+	  request.done( ( error=="" ) ? buffer : nullptr, error );
+	}
+	catch ( std::exception& e ) {
+	  std::cout << "[AsyncNavigator] callback failed: " << e.what() << std::endl;
+	}
+      }
+
+      std::lock_guard<std::mutex> guard( fMutex );
+      fBusy = false;
+    }
+  }
+
+  AsyncNavigator::Result_t AsyncNavigator::goto_entry_async( Entry_t entry, std::string ftype ) {
+    return submit( [entry,ftype]( DataCoordinator& dataco ) { dataco.goto_entry( entry, ftype ); }, Callback_t() );
+  }
+
+  AsyncNavigator::Result_t AsyncNavigator::goto_event_async( int run, int subrun, int event, std::string ftype_driver ) {
+    return submit( [run,subrun,event,ftype_driver]( DataCoordinator& dataco ) { dataco.goto_event( run, subrun, event, ftype_driver ); },
+		   Callback_t() );
+  }
+
+  void AsyncNavigator::goto_entry_async( Entry_t entry, std::string ftype, Callback_t done ) {
+    submit( [entry,ftype]( DataCoordinator& dataco ) { dataco.goto_entry( entry, ftype ); }, done );
+  }
+
+  void AsyncNavigator::goto_event_async( int run, int subrun, int event, std::string ftype_driver, Callback_t done ) {
+    submit( [run,subrun,event,ftype_driver]( DataCoordinator& dataco ) { dataco.goto_event( run, subrun, event, ftype_driver ); },
+	    done );
+  }
+
+  size_t AsyncNavigator::pending() {
+    std::lock_guard<std::mutex> guard( fMutex );
+    return fRequests.size() + ( fBusy ? 1 : 0 );
+  }
+
+  bool AsyncNavigator::is_ready( const Result_t& result ) {
+    return result.wait_for( std::chrono::seconds(0) )==std::future_status::ready;
+  }
+
+}
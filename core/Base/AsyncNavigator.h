@@ -0,0 +1,89 @@
+#ifndef __ASYNC_NAVIGATOR__
+#define __ASYNC_NAVIGATOR__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "FileManagerTypes.h"
+#include "DataCoordinator.h"
+
+namespace larlitecv {
+
+  // goto_entry/goto_event without blocking the caller, for interactive tools.
+  //
+  // Requests are carried out in order on one I/O thread. Each request moves one of nbuffers
+  // DataCoordinators (sharing the source's index) to the event, and hands that DataCoordinator back
+  // through a future or a callback. Buffers are used round robin, so the event of one request stays
+  // valid until nbuffers further requests have been made: with the default two, a UI can look at the
+  // current event while the next one loads.
+  //
+  //   AsyncNavigator nav( dataco );                          // dataco configured read-only (IOMode 0)
+  //   AsyncNavigator::Result_t next = nav.goto_entry_async( 0, "larcv" );
+  //   while ( ... ) {
+  //     DataCoordinator* current = next.get();               // waits, or rethrows the request's error
+  //     next = nav.goto_entry_async( ++entry, "larcv" );     // starts loading the next event
+  //     draw( current->get_larcv_data( larcv::kProductImage2D, "tpc" ) );
+  //   }
+  //
+  // Callbacks run on the I/O thread, with the DataCoordinator, or with nullptr and the error message.
+  // The buffers open their files on the I/O thread, on their first request.
+
+  class AsyncNavigator {
+
+  public:
+
+    typedef std::shared_future< DataCoordinator* > Result_t;
+    typedef std::function< void( DataCoordinator* dataco, const std::string& error ) > Callback_t;
+
+    AsyncNavigator( DataCoordinator& source, int nbuffers=2 );
+    virtual ~AsyncNavigator(); ///< finishes the requests already made
+    AsyncNavigator( const AsyncNavigator& ) = delete;
+    AsyncNavigator& operator=( const AsyncNavigator& ) = delete;
+
+    Result_t goto_entry_async( Entry_t entry, std::string ftype );
+    Result_t goto_event_async( int run, int subrun, int event, std::string ftype_driver );
+    void goto_entry_async( Entry_t entry, std::string ftype, Callback_t done );
+    void goto_event_async( int run, int subrun, int event, std::string ftype_driver, Callback_t done );
+
+    size_t pending();                              ///< requests not yet finished
+    static bool is_ready( const Result_t& result ); ///< true once get() would not wait
+
+  protected:
+
+    typedef std::function< void( DataCoordinator& dataco ) > Move_t;
+
+    struct Request {
+      Move_t move;
+      int ibuffer;
+      std::shared_ptr< std::promise<DataCoordinator*> > promise;
+      Callback_t done;
+    };
+
+    Result_t submit( Move_t move, Callback_t done );
+    void io_loop();
+
+    // nothing here is streamable: every member is transient (//!)
+    DataCoordinator* fSource;                  //!
+    std::vector< DataCoordinator* > fBuffers;  //!
+    // set on the I/O thread, read in the destructor. std::vector<bool> packs its bits, so this is
+    // only safe because the destructor joins the I/O thread first.
+    std::vector< bool > fOpened;               //!
+    int fNextBuffer;                           //!
+    std::deque< Request > fRequests;           //!
+    bool fBusy;                                //! the I/O thread is carrying out a request
+    bool fStop;                                //!
+    std::mutex fMutex;                         //!
+    std::condition_variable fWake;             //!
+    std::thread fThread;                       //!
+  };
+
+}
+
+#endif
@@ -2,13 +2,24 @@
 #include "FileManager.h"
 #include "LarcvFileManager.h"
 #include "LarliteFileManager.h"
+#include "ShardPlanner.h"
+#include "IndexSummary.h"
+#include "OutputMerger.h"
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <sstream>
+#include <set>
 #include <assert.h>
+#include <cstdlib>
+#include <chrono>
+#include <climits>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
 #include "Base/LArCVBaseUtilFunc.h"
 #include "Base/larcv_logger.h"
+#include "DataFormat/ProductMap.h"
 
 namespace larlitecv {
 
@@ -21,16 +32,57 @@ namespace larlitecv {
     user_filepaths.clear();
     user_filelists.clear();
     user_outpath.clear();
+    fIndexDaemonSocket = "";
+    fUseIndexCache = true;
+    fOrdered = nullptr;
+    fSelectRSE = false;
+    fSelectDriver = "larcv";
+    fEventListFile = "";
+    fMetadataFile = "";
+    fEventListDriver = "larcv";
+    fRestoreListOrder = false;
+    fListCursor = 0;
+    fListPos = -1;
+    fCheckpointFile = "";
+    fCheckpointEvery = 1000;
+    fResumeEntry = 0;
+    fNextEntry = 0;
+    fUncommitted = 0;
+    fSegment = 0;
+    fOrderedDriver = "";
+    fPruneToReadOnly = false;
+    fOutOfCoreIndex = false;
+    fOutOfCoreDir = ".pylardcache";
+    const char* indexd_socket = getenv( "LARLITECV_INDEXD_SOCKET" );
+    if ( indexd_socket ) fIndexDaemonSocket = indexd_socket;
+    fShardIndex = 0;
+    fNumShards = 1;
+    fShardDriver = "larcv";
+    fCostSidecar = "";
+    fCostPending = false;
+    fCostStart = 0.;
+    fOwnsManagers = true;
+    fIndexReady = false;
+    fEmptySelection = false;
     fInit = false;
     fManagerList.push_back("larlite");
     fManagerList.push_back("larcv");
     larcv_unused = true;
     larlite_unused = true;
+    fLarliteReader = &larlite_io;
+    fLarcvReader   = &larcv_io;
+    fLazyOpen = false;
+    fMaxOpenBlocks = 4;
+    fLazyLarlite = false;
+    fLazyLarcv = false;
+    fLarliteReaders.set_closer( []( larlite::storage_manager* reader ) { reader->close(); } );
+    fLarcvReaders.set_closer( []( larcv::IOManager* reader ) { reader->finalize(); } );
   }
 
   DataCoordinator::~DataCoordinator() {
+    delete fOrdered;
     for ( auto &iter : fManagers ) {
-      delete iter.second;
+      if ( fOwnsManagers ) delete iter.second;
       iter.second = nullptr;
     }
   }
@@ -56,12 +108,364 @@ namespace larlitecv {
     user_outpath.insert( std::pair< std::string, std::string >( ftype, filepath ) );
   }
 
-  void DataCoordinator::initialize() {
-    if ( fInit ) {
-      std::cout << "Already initialized!" << std::endl;
+  void DataCoordinator::set_shard( int ishard, int nshards, std::string ftype_driver ) {
+    if ( nshards<1 || ishard<0 || ishard>=nshards ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " invalid shard " << ishard << " of " << nshards << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    fShardIndex  = ishard;
+    fNumShards   = nshards;
+    fShardDriver = ftype_driver;
+  }
+
+  void DataCoordinator::select_runs( int run_lo, int run_hi, std::string ftype_driver ) {
+    fSelectRSE    = true;
+    fSelectLo     = RSE( run_lo, INT_MIN, INT_MIN, INT_MIN );
+    fSelectHi     = RSE( run_hi, INT_MAX, INT_MAX, INT_MAX );
+    fSelectDriver = ftype_driver;
+  }
+
+  void DataCoordinator::select_subrun( int run, int subrun, std::string ftype_driver ) {
+    fSelectRSE    = true;
+    fSelectLo     = RSE( run, subrun, INT_MIN, INT_MIN );
+    fSelectHi     = RSE( run, subrun, INT_MAX, INT_MAX );
+    fSelectDriver = ftype_driver;
+  }
+
+  void DataCoordinator::apply_selection() {
+    // both file types keep the blocks holding selected events. the sorted index finds them
+    // without visiting the other entries.
+    for ( auto& iter : fManagers ) {
+      FileManager* fman = iter.second;
+      if ( fman->nentries()==0 ) continue;
+      size_t nfiles = fman->get_final_filelist().size();
+      fman->restrict_to_blocks( fman->getBlocksOf( fman->findEntryRanges( fSelectLo, fSelectHi ) ) );
+      std::cout << "[DataCoordinator] selection (" << fSelectLo.run << "," << fSelectLo.subrun << ")-("
+		<< fSelectHi.run << "," << fSelectHi.subrun << "): " << iter.first << " "
+		<< fman->get_final_filelist().size() << " of " << nfiles << " files" << std::endl;
+    }
+  }
+
+  void DataCoordinator::set_event_list( std::string listfile, std::string ftype_driver, bool restore_order ) {
+    fEventListFile    = listfile;
+    fMetadataFile     = "";
+    fEventListDriver  = ftype_driver;
+    fRestoreListOrder = restore_order;
+  }
+
+  void DataCoordinator::select_by_metadata( std::string sidecar, const std::vector<MetadataCut>& cuts, std::string ftype_driver ) {
+    fMetadataFile    = sidecar;
+    fMetadataCuts    = cuts;
+    fEventListFile   = "";
+    fEventListDriver = ftype_driver;
+  }
+
+  void DataCoordinator::apply_event_list() {
+    std::vector<RSE> events;
+    if ( fMetadataFile!="" ) {
+      EventMetadata metadata;
+      if ( !metadata.load( fMetadataFile ) ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " could not read event metadata " << fMetadataFile << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      events = metadata.select( fMetadataCuts );
+      std::cout << "[DataCoordinator] " << events.size() << " of " << metadata.size() << " events in " << fMetadataFile
+		<< " pass the metadata cuts" << std::endl;
+    }
+    else {
+      std::ifstream infile( fEventListFile.c_str() );
+      if ( !infile.good() ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " could not read event list " << fEventListFile << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      std::string line;
+      while ( std::getline( infile, line ) ) {
+	size_t comment = line.find('#');
+	if ( comment!=std::string::npos ) line = line.substr( 0, comment );
+	std::stringstream ss( line );
+	int run, subrun, event;
+	if ( ss >> run >> subrun >> event ) events.push_back( RSE( run, subrun, event ) );
+      }
+    }
+
+    std::string driver = fEventListDriver;
+    std::string other  = ( driver=="larcv" ) ? "larlite" : "larcv";
+    if ( fManagers[driver]->nentries()==0 ) std::swap( driver, other );
+    FileManager* fdriver = fManagers[driver];
+    FileManager* fother  = fManagers[other];
+
+    // keep only the blocks holding listed events, then look the events up again in the smaller index
+    std::set<int> driver_blocks;
+    std::set<int> other_blocks;
+    for ( auto const& rse : events ) {
+      Entry_t entry = fdriver->findEntry( rse );
+      if ( entry>=0 ) driver_blocks.insert( fdriver->getFileBlock( entry ) );
+      Entry_t other_entry = fother->findEntry( rse );
+      if ( other_entry>=0 ) other_blocks.insert( fother->getFileBlock( other_entry ) );
+    }
+    fdriver->restrict_to_blocks( std::vector<int>( driver_blocks.begin(), driver_blocks.end() ) );
+    if ( fother->nentries()>0 )
+      fother->restrict_to_blocks( std::vector<int>( other_blocks.begin(), other_blocks.end() ) );
+
+    fListed.clear();
+    int64_t nmissing = 0;
+    for ( size_t ievent=0; ievent<events.size(); ievent++ ) {
+      Entry_t entry = fdriver->findEntry( events[ievent] );
+      if ( entry<0 ) nmissing++;
+      else fListed.push_back( std::make_pair( entry, (int64_t)ievent ) );
+    }
+    // entries are numbered block by block and file by file, so entry order is file order
+    std::sort( fListed.begin(), fListed.end() );
+    fListCursor = 0;
+    fEventListDriver = driver;
+
+    std::string listname = ( fMetadataFile!="" ) ? fMetadataFile : fEventListFile;
+    std::cout << "[DataCoordinator] event list " << listname << ": " << fListed.size() << " of " << events.size()
+	      << " events found in " << fdriver->get_final_filelist().size() << " " << driver << " files" << std::endl;
+    if ( nmissing>0 )
+      std::cout << "[DataCoordinator] " << nmissing << " listed events are not in the " << driver << " index" << std::endl;
+    if ( fListed.empty() ) fEmptySelection = true;
+  }
+
+  bool DataCoordinator::goto_next_listed() {
+    if ( fListCursor>=fListed.size() ) return false;
+    fListPos = fListed[fListCursor].second;
+    goto_entry( fListed[fListCursor].first, fEventListDriver );
+    fListCursor++;
+    return true;
+  }
+
+  void DataCoordinator::restore_list_order() {
+    // output entry i was saved while visiting list position fSavedListPos[i]. copy each output file
+    // into a new one, entries taken in list order.
+    std::vector<Entry_t> order( fSavedListPos.size() );
+    for ( size_t i=0; i<order.size(); i++ ) order[i] = (Entry_t)i;
+    std::stable_sort( order.begin(), order.end(), [this]( Entry_t a, Entry_t b ) { return fSavedListPos[a]<fSavedListPos[b]; } );
+    fSavedListPos.clear();
+    bool sorted = true;
+    for ( size_t i=0; i<order.size(); i++ ) sorted = sorted && order[i]==(Entry_t)i;
+    if ( sorted ) return;
+
+    std::string ftypes[2] = { "larlite", "larcv" };
+    bool unused[2] = { larlite_unused, larcv_unused };
+    for ( int itype=0; itype<2; itype++ ) {
+      std::string outfile = get_outputfile( ftypes[itype] );
+      if ( unused[itype] || outfile=="" ) continue;
+      if ( OutputMerger::reorder( outfile, ftypes[itype], order ) )
+	std::cout << "[DataCoordinator] " << outfile << " rewritten in event list order" << std::endl;
+      else
+	std::cout << "[DataCoordinator] " << outfile << " stays in processing order." << std::endl;
+    }
+  }
+
+  void DataCoordinator::set_checkpoint( std::string checkpoint_file, Entry_t every ) {
+    fCheckpointFile  = checkpoint_file;
+    fCheckpointEvery = every;
+  }
+
+  void DataCoordinator::start_segment() {
+    // outputs are written as <output>_seg<N>.root until finalize merges them
+    for ( auto const& iter : fFinalOutputs ) {
+      if ( iter.second=="" ) continue;
+      user_outpath[iter.first] = OutputMerger::worker_filename( iter.second, "seg", fSegment );
+    }
+  }
+
+  void DataCoordinator::load_checkpoint() {
+    // checkpoint file: one "key values..." line per item
+    //   next_entry <entry> | next_segment <n> | nentries <ftype> <n> | segment <ftype> <path> | seed <name> <value>
+    for ( auto const& ftype : fManagerList ) fFinalOutputs[ftype] = get_outputfile( ftype );
+    fSegments.clear();
+    fSegment = 0;
+    fResumeEntry = 0;
+
+    std::ifstream infile( fCheckpointFile.c_str() );
+    if ( infile.good() ) {
+      std::string line;
+      while ( std::getline( infile, line ) ) {
+	std::stringstream ss( line );
+	std::string key;
+	ss >> key;
+	if ( key=="next_entry" ) ss >> fResumeEntry;
+	else if ( key=="next_segment" ) ss >> fSegment;
+	else if ( key=="segment" ) {
+	  std::string ftype, path;
+	  ss >> ftype >> path;
+	  fSegments[ftype].push_back( path );
+	}
+	else if ( key=="nentries" ) {
+	  // resuming against a different index would skip or repeat events
+	  std::string ftype;
+	  Entry_t nentries;
+	  ss >> ftype >> nentries;
+	  if ( get_nentries( ftype )!=nentries ) {
+	    std::stringstream msg;
+	    msg << __FILE__ << ":" << __LINE__ << " checkpoint " << fCheckpointFile << " was written for " << nentries << " "
+		<< ftype << " entries, the index now has " << get_nentries( ftype ) << std::endl;
+	    throw std::runtime_error( msg.str() );
+	  }
+	}
+	else if ( key=="seed" ) {
+	  std::string name;
+	  int64_t value;
+	  ss >> name >> value;
+	  auto iter = fSeeds.find( name );
+	  if ( iter!=fSeeds.end() ) *(iter->second) = value;
+	}
+      }
+      std::cout << "[DataCoordinator] resuming from " << fCheckpointFile << " at entry " << fResumeEntry
+		<< ", output segment " << fSegment << std::endl;
+    }
+    fNextEntry = fResumeEntry;
+    fUncommitted = 0;
+    start_segment();
+  }
+
+  void DataCoordinator::write_checkpoint() {
+    // write next to the target and rename, so a job killed meanwhile leaves the previous checkpoint
+    std::stringstream tmpname;
+    tmpname << fCheckpointFile << ".tmp" << getpid();
+    std::ofstream outfile( tmpname.str().c_str() );
+    outfile << "next_entry " << fNextEntry << "\n";
+    outfile << "next_segment " << fSegment << "\n";
+    for ( auto const& ftype : fManagerList ) outfile << "nentries " << ftype << " " << get_nentries( ftype ) << "\n";
+    for ( auto const& iter : fSegments ) {
+      for ( auto const& path : iter.second ) outfile << "segment " << iter.first << " " << path << "\n";
+    }
+    for ( auto const& iter : fSeeds ) outfile << "seed " << iter.first << " " << *(iter.second) << "\n";
+    outfile.close();
+    if ( outfile.fail() || std::rename( tmpname.str().c_str(), fCheckpointFile.c_str() )!=0 ) {
+      std::cout << "[DataCoordinator] could not write checkpoint " << fCheckpointFile << std::endl;
+      std::remove( tmpname.str().c_str() );
+    }
+  }
+
+  void DataCoordinator::commit_entry( Entry_t entry ) {
+    fNextEntry = entry+1;
+    fUncommitted++;
+    if ( fCheckpointFile!="" && fCheckpointEvery>0 && fUncommitted>=fCheckpointEvery ) checkpoint();
+  }
+
+  void DataCoordinator::checkpoint() {
+    if ( fCheckpointFile=="" ) return;
+    // committed entries are only safe once their output file is closed: close this segment, start the next
+    bool writing = false;
+    for ( auto const& iter : fFinalOutputs ) writing = writing || iter.second!="";
+    if ( writing ) {
+      // only the written types are reopened: read-only inputs, and blocks opened on demand, stay open.
+      // a type that is read and written (IOMode 2) has one manager for both, so its inputs are reopened too.
+      bool larlite_written = fFinalOutputs["larlite"]!="";
+      bool larcv_written   = fFinalOutputs["larcv"]!="";
+      if ( larlite_written ) {
+	larlite_io.close();
+	larlite_io.reset();
+      }
+      if ( larcv_written ) {
+	larcv_io.finalize();
+	larcv_io.reset();
+      }
+      write_index_summaries();
+      for ( auto const& iter : fFinalOutputs ) {
+	if ( iter.second!="" ) fSegments[iter.first].push_back( user_outpath[iter.first] );
+      }
+      fSegment++;
+      start_segment();
+      if ( larlite_written ) open_larlite();
+      if ( larcv_written )   open_larcv();
+    }
+    write_checkpoint();
+    fUncommitted = 0;
+  }
+
+  void DataCoordinator::finish_checkpoints() {
+    // the job is complete: merge the segments into the requested outputs
+    if ( fEmptySelection ) {
+      std::remove( fCheckpointFile.c_str() );
       return;
     }
-    std::cout << "[DataCoodinator] Initializing" << std::endl;
+    bool ok = true;
+    for ( auto const& iter : fFinalOutputs ) {
+      if ( iter.second=="" ) continue;
+      std::vector<std::string> inputs = fSegments[iter.first];
+      inputs.push_back( user_outpath[iter.first] );
+      if ( !OutputMerger::merge( inputs, iter.second ) ) {
+	std::cout << "[DataCoordinator] could not merge output segments into " << iter.second << std::endl;
+	ok = false;
+      }
+      user_outpath[iter.first] = iter.second;
+    }
+    if ( ok ) std::remove( fCheckpointFile.c_str() );
+  }
+
+  void DataCoordinator::record_event_costs( std::string sidecar ) {
+    fCostSidecar = sidecar;
+    fRecordedCosts.clear();
+    fRecordedCosts.load( sidecar ); // keep what earlier runs measured
+  }
+
+  void DataCoordinator::use_event_costs( std::string sidecar ) {
+    fPlanningCosts.clear();
+    if ( !fPlanningCosts.load( sidecar ) )
+      std::cout << "[DataCoordinator] could not read event costs from " << sidecar << ". Balancing by number of entries." << std::endl;
+  }
+
+  static double cost_clock() {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+  }
+
+  void DataCoordinator::start_event_cost( int run, int subrun, int event ) {
+    fCostRSE = RSE( run, subrun, event );
+    fCostStart = cost_clock();
+    fCostPending = true;
+  }
+
+  void DataCoordinator::stop_event_cost() {
+    if ( !fCostPending ) return;
+    fRecordedCosts.record( fCostRSE, (float)( cost_clock()-fCostStart ) );
+    fCostPending = false;
+  }
+
+  void DataCoordinator::apply_shard() {
+    // cut the driver's index into balanced groups of whole file blocks
+    std::string driver = fShardDriver;
+    std::string other  = ( driver=="larcv" ) ? "larlite" : "larcv";
+    if ( fManagers[driver]->nentries()==0 ) std::swap( driver, other );
+    FileManager* fdriver = fManagers[driver];
+    FileManager* fother  = fManagers[other];
+
+    std::vector<double> weights;
+    if ( fPlanningCosts.size()>0 )
+      weights = fPlanningCosts.block_costs( *fdriver );
+    else
+      weights = ShardPlanner::entry_weights( fdriver->get_fileblocks() );
+    std::vector<int> driver_blocks = ShardPlanner::plan( weights, fShardIndex, fNumShards );
+
+    // the other file type keeps every block that holds an event of this shard
+    std::set<int> other_blocks;
+    for ( auto const& iblock : driver_blocks ) {
+      const FileBlock& block = fdriver->get_fileblocks().at(iblock);
+      for ( Entry_t entry=block.first_entry; entry<block.first_entry+block.nentries; entry++ ) {
+	int run, subrun, event;
+	fdriver->getRSE( entry, run, subrun, event );
+	Entry_t other_entry = fother->findEntry( RSE(run,subrun,event) );
+	if ( other_entry>=0 ) other_blocks.insert( fother->getFileBlock( other_entry ) );
+      }
+    }
+
+    fdriver->restrict_to_blocks( driver_blocks );
+    fother->restrict_to_blocks( std::vector<int>( other_blocks.begin(), other_blocks.end() ) );
+    if ( driver_blocks.empty() ) fEmptySelection = true;
+
+    std::cout << "[DataCoordinator] shard " << fShardIndex << " of " << fNumShards << ": "
+	      << driver << " " << fdriver->nentries() << " entries in " << fdriver->get_final_filelist().size() << " files, "
+	      << other << " " << fother->nentries() << " entries in " << fother->get_final_filelist().size() << " files." << std::endl;
+  }
+
+  void DataCoordinator::initialize_index() {
+    if ( fIndexReady ) return;
 
     prepfilelists();
 
@@ -75,8 +479,8 @@ namespace larlitecv {
     }
 
     // create manager instances
-    LarliteFileManager* flarlite = new LarliteFileManager( user_filelists["larlite"] );
-    LarcvFileManager*     flarcv = new LarcvFileManager( user_filelists["larcv"] );
+    LarliteFileManager* flarlite = new LarliteFileManager( user_filelists["larlite"], fUseIndexCache );
+    LarcvFileManager*     flarcv = new LarcvFileManager( user_filelists["larcv"], fUseIndexCache );
     
     // pass the filelists to the managers
     fManagers.insert( std::pair< std::string, FileManager* >( "larlite", flarlite ) );
@@ -85,28 +489,152 @@ namespace larlitecv {
     // this builds the indices, allowing us to sync the processing
     for (auto &iter : fManagers ) {
       std::cout << "[DataCoordinator] initializing filemanager for " << iter.first << std::endl;
+      if ( fIndexDaemonSocket!="" ) iter.second->setDaemonSocket( fIndexDaemonSocket );
+      iter.second->setOutOfCore( fOutOfCoreIndex, fOutOfCoreDir );
+      std::vector<std::string> required = fRequiredTrees[iter.first];
+      if ( fPruneToReadOnly ) {
+	std::vector<std::string> readonly = readonly_trees( iter.first );
+	required.insert( required.end(), readonly.begin(), readonly.end() );
+      }
+      if ( !required.empty() ) iter.second->setRequiredTrees( required );
       iter.second->initialize();
       std::cout << "  " << iter.first << " loading " << iter.second->get_final_filelist().size() << " files." << std::endl;      
     }
 
-    // now we setup the iomanagers
+    // keep only the files holding selected runs, then only those of our shard
+    if ( fSelectRSE ) apply_selection();
+    if ( fNumShards>1 ) apply_shard();
+    if ( fEventListFile!="" || fMetadataFile!="" ) apply_event_list();
+    if ( fSelectRSE ) {
+      std::string driver = fSelectDriver;
+      if ( fManagers[driver]->nentries()==0 ) driver = ( driver=="larcv" ) ? "larlite" : "larcv";
+      fSelection = fManagers[driver]->findEntryRanges( fSelectLo, fSelectHi );
+    }
 
-    // configure them
-    larcv_io.configure( larcv_pset );  // we use the configure function
-    do_larlite_config( larlite_io, larlite_pset ); // we have to add one for larlite
-    
-    // user may have override output file (for larcv...)
-    auto lc_iter = user_outpath.find("larcv");
-    if (lc_iter != user_outpath.end()) {
-      auto fname = (*lc_iter).second;
-      assert(!fname.empty());
-      larcv_io.set_out_file(fname);
+    fIndexReady = true;
+  }
+
+  void DataCoordinator::require_product( std::string ftype, std::string datatype, std::string producer ) {
+    if ( ftype!="larlite" && ftype!="larcv" ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " unknown file type '" << ftype << "'" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    // both formats name a product's tree <datatype>_<producer>_tree
+    fRequiredTrees[ftype].push_back( datatype+"_"+producer+"_tree" );
+  }
+
+  std::vector<std::string> DataCoordinator::readonly_trees( std::string ftype ) {
+    std::vector<std::string> trees;
+    if ( ftype=="larlite" ) {
+      auto types     = larlite_pset.get<std::vector<std::string> >( "ReadOnlyDataTypes", std::vector<std::string>() );
+      auto producers = larlite_pset.get<std::vector<std::string> >( "ReadOnlyProducers", std::vector<std::string>() );
+      for ( size_t i=0; i<types.size() && i<producers.size(); i++ )
+	trees.push_back( types[i]+"_"+producers[i]+"_tree" );
+    }
+    else if ( ftype=="larcv" ) {
+      auto types     = larcv_pset.get<std::vector<unsigned short> >( "ReadOnlyDataType", std::vector<unsigned short>() );
+      auto producers = larcv_pset.get<std::vector<std::string> >( "ReadOnlyDataName", std::vector<std::string>() );
+      for ( size_t i=0; i<types.size() && i<producers.size(); i++ )
+	trees.push_back( larcv::ProductName( (larcv::ProductType_t)types[i] )+"_"+producers[i]+"_tree" );
+    }
+    return trees;
+  }
+
+  void DataCoordinator::share_index( const DataCoordinator& source ) {
+    if ( !source.fIndexReady ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " source DataCoordinator has not built its index yet." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    if ( fIndexReady ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " this DataCoordinator already has an index." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    // the managers are only read from here on, so any number of coordinators can use them
+    fManagers      = source.fManagers;
+    fOwnsManagers  = false;
+    larlite_pset   = source.larlite_pset;
+    larcv_pset     = source.larcv_pset;
+    fPlanningCosts = source.fPlanningCosts;
+    fLazyOpen      = source.fLazyOpen;
+    fSelection     = source.fSelection;
+    fMaxOpenBlocks = source.fMaxOpenBlocks;
+    fEmptySelection = source.fEmptySelection;
+    fIndexReady    = true;
+  }
+
+  std::string DataCoordinator::get_outputfile( std::string ftype ) const {
+    // nothing is written in read-only (0) or unused (-1) mode
+    const larcv::PSet& pset = ( ftype=="larlite" ) ? larlite_pset : larcv_pset;
+    int iomode = pset.get<int>( "IOMode", 0 );
+    if ( iomode!=1 && iomode!=2 ) return "";
+
+    auto iter = user_outpath.find( ftype );
+    if ( iter!=user_outpath.end() ) return iter->second;
+    if ( ftype=="larlite" ) return larlite_pset.get<std::string>( "OutFileName", "" );
+    if ( ftype=="larcv" )   return larcv_pset.get<std::string>( "OutFileName", "" );
+    return "";
+  }
+
+  void DataCoordinator::set_read_only() {
+    if ( fInit ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " set_read_only() must be called before initialize()" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    // unused types (-1) stay unused
+    if ( larlite_pset.get<int>( "IOMode", 0 )>0 ) larlite_pset = with_iomode( larlite_pset, 0 );
+    if ( larcv_pset.get<int>( "IOMode", 0 )>0 )   larcv_pset   = with_iomode( larcv_pset, 0 );
+    user_outpath.clear();
+  }
+
+  larcv::PSet DataCoordinator::with_iomode( const larcv::PSet& pset, int iomode ) {
+    // a PSet's values cannot be overwritten: copy everything but IOMode
+    larcv::PSet copy( pset.name() );
+    for ( auto const& key : pset.value_keys() ) {
+      if ( key!="IOMode" ) copy.add_value( key, pset.get<std::string>( key ) );
+    }
+    for ( auto const& key : pset.pset_keys() ) copy.add_pset( pset.get<larcv::PSet>( key ) );
+    std::stringstream mode;
+    mode << iomode;
+    copy.add_value( "IOMode", mode.str() );
+    return copy;
+  }
+
+  void DataCoordinator::initialize() {
+    if ( fInit ) {
+      std::cout << "Already initialized!" << std::endl;
+      return;
     }
+    std::cout << "[DataCoodinator] Initializing" << std::endl;
+
+    initialize_index();
+    if ( !fIndexReady ) return;
+
+    if ( fCheckpointFile!="" ) load_checkpoint();
+
+    open_io();
+  }
+
+  void DataCoordinator::open_io() {
+    // now we setup the iomanagers
 
     // get the iomode for larcv/larlite
     fIOmodes["larcv"]   = (int)larcv_pset.get<int>("IOMode",0);
     fIOmodes["larlite"] = (int)larlite_pset.get<int>("IOMode",0);
 
+    if ( fEmptySelection ) {
+      // nothing to read or write: get_nentries is 0 and no file is opened
+      larcv_unused = true;
+      larlite_unused = true;
+      fLazyLarlite = false;
+      fLazyLarcv = false;
+      std::cout << "[DataCoordinator] no entries selected. no files opened." << std::endl;
+      return;
+    }
+
     // determine if any of the inputs are unused
     larcv_unused = false;
     larlite_unused = false;
@@ -119,24 +647,26 @@ namespace larlitecv {
     if ( fIOmodes["larcv"]==0  && fManagers["larcv"]->get_final_filelist().empty()  ) larcv_unused = true;
     if ( fIOmodes["larlite"]==0 && fManagers["larlite"]->get_final_filelist().empty()) larlite_unused = true;
 
-    //
-    // now load input files
-    //
-    // larlite iomanager
-    if ( !larlite_unused ) {
-      for ( auto const &larlitefile : fManagers["larlite"]->get_final_filelist() ) {
-	larlite_io.add_in_filename( larlitefile );
-      }
-      larlite_io.open();
-      larlite_io.enable_event_alignment(false);
-    }
-    // larcv iomanager
-    if ( !larcv_unused ) {
-      for ( auto const &larcvfile : fManagers["larcv"]->get_final_filelist() ) {
-	larcv_io.add_in_file( larcvfile );
-      }
-      larcv_io.initialize();      
+    // read-only types can open their files block by block, as entries are visited. larlite's
+    // storage_manager addresses entries with 32 bits: a larger index must be read block by block.
+    bool larlite_too_big = !larlite_unused && fManagers["larlite"]->nentries()>(Entry_t)UINT32_MAX;
+    if ( larlite_too_big && fIOmodes["larlite"]!=0 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " " << fManagers["larlite"]->nentries() << " larlite entries: more than storage_manager can address."
+	 << " only a read-only (IOMode 0) larlite input can be this large." << std::endl;
+      throw std::runtime_error( ss.str() );
     }
+    if ( larlite_too_big && !fLazyOpen )
+      std::cout << "[DataCoordinator] more than 2^32 larlite entries: larlite files are opened block by block" << std::endl;
+    fLazyLarlite = ( fLazyOpen || larlite_too_big ) && !larlite_unused && fIOmodes["larlite"]==0;
+    fLazyLarcv   = fLazyOpen && !larcv_unused   && fIOmodes["larcv"]==0;
+    fLarliteReaders.set_capacity( fMaxOpenBlocks );
+    fLarcvReaders.set_capacity( fMaxOpenBlocks );
+    if ( fLazyLarlite ) std::cout << "[DataCoordinator] larlite files opened on demand, at most " << fMaxOpenBlocks << " blocks at a time" << std::endl;
+    if ( fLazyLarcv )   std::cout << "[DataCoordinator] larcv files opened on demand, at most " << fMaxOpenBlocks << " blocks at a time" << std::endl;
+
+    open_larlite();
+    open_larcv();
 
     if ( larlite_unused && larcv_unused ) {
       std::cout << "Both LARCV and LARLITE unused. Must be an error." << std::endl;
@@ -148,16 +678,89 @@ namespace larlitecv {
 
   }
 
+  void DataCoordinator::open_larlite() {
+    // configure larlite_io, then open its input files and output
+    auto ll_iter = user_outpath.find("larlite");
+    if ( ll_iter!=user_outpath.end() && !ll_iter->second.empty() )
+      larlite_io.set_out_filename( ll_iter->second );
+    do_larlite_config( larlite_io, larlite_pset ); // we have to add one for larlite
+    if ( larlite_unused || fLazyLarlite ) return;
+    for ( auto const &larlitefile : fManagers["larlite"]->get_final_filelist() ) {
+      larlite_io.add_in_filename( larlitefile );
+    }
+    larlite_io.open();
+    larlite_io.enable_event_alignment(false);
+  }
+
+  void DataCoordinator::open_larcv() {
+    larcv_io.configure( larcv_pset );  // we use the configure function
+    // user may have override output file (for larcv...)
+    auto lc_iter = user_outpath.find("larcv");
+    if (lc_iter != user_outpath.end()) {
+      auto fname = (*lc_iter).second;
+      assert(!fname.empty());
+      larcv_io.set_out_file(fname);
+    }
+    if ( larcv_unused || fLazyLarcv ) return;
+    for ( auto const &larcvfile : fManagers["larcv"]->get_final_filelist() ) {
+      larcv_io.add_in_file( larcvfile );
+    }
+    larcv_io.initialize();
+  }
+
   void DataCoordinator::close() {
+    fLarliteReaders.clear();
+    fLarcvReaders.clear();
+    fLarliteReader = &larlite_io;
+    fLarcvReader   = &larcv_io;
     larlite_io.close();
     larcv_io.reset();
   }
   
+  void DataCoordinator::close_io() {
+    if ( !larlite_unused ) {
+      if ( fLazyLarlite ) fLarliteReaders.clear();
+      else larlite_io.close();
+    }
+    if ( !larcv_unused ) {
+      if ( fLazyLarcv ) fLarcvReaders.clear();
+      else larcv_io.finalize();
+    }
+    fLarliteReader = &larlite_io;
+    fLarcvReader   = &larcv_io;
+    write_index_summaries();
+  }
+
   void DataCoordinator::finalize() {
-    if ( !larlite_unused ) larlite_io.close();
-    if ( !larcv_unused )   larcv_io.finalize();
+    close_io();
+    if ( fCheckpointFile!="" ) finish_checkpoints();
+    if ( fRestoreListOrder && fResumeEntry>0 ) {
+      // the segments written before the resume have no saved list positions
+      std::cout << "[DataCoordinator] resumed job: outputs are left in processing order" << std::endl;
+      fSavedListPos.clear();
+    }
+    else if ( fRestoreListOrder ) restore_list_order();
+    if ( fCostSidecar!="" ) {
+      stop_event_cost();
+      if ( !fRecordedCosts.save( fCostSidecar ) )
+	std::cout << "[DataCoordinator] could not write event costs to " << fCostSidecar << std::endl;
+    }
   }
   
+  void DataCoordinator::write_index_summaries() {
+    // the output files are closed by now. each gets the RSEs of the entries we saved into it.
+    if ( fSavedRSE.size()==0 ) return;
+    std::string ftypes[2] = { "larlite", "larcv" };
+    bool unused[2] = { larlite_unused, larcv_unused };
+    for ( int itype=0; itype<2; itype++ ) {
+      std::string outfile = get_outputfile( ftypes[itype] );
+      if ( unused[itype] || outfile=="" ) continue;
+      if ( !IndexSummary::write( outfile, fSavedRSE ) )
+	std::cout << "[DataCoordinator] could not write index summary into " << outfile << std::endl;
+    }
+    fSavedRSE.clear();
+  }
+
   void DataCoordinator::prepfilelists() {
     /// prepare the filelists for the different managers
 
@@ -260,22 +863,86 @@ namespace larlitecv {
 
   }
 
-  void DataCoordinator::goto_entry( int entry, std::string ftype_driver ) {
-    int run, subrun, event, other_entry;
+  void DataCoordinator::read_larlite( Entry_t entry, bool store ) {
+    // larlite's storage_manager addresses entries with 32 bits. open_io() reads larger indices
+    // block by block, so only a block holding more than 2^32 entries ends up here.
+    if ( !fLazyLarlite ) {
+      larlite_io.go_to( larlite_entry( entry ), store );
+      return;
+    }
+    int iblock;
+    Entry_t local_entry;
+    if ( !fManagers["larlite"]->locate( entry, iblock, local_entry ) ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " larlite entry " << entry << " is not in the index." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    larlite::storage_manager* reader = fLarliteReaders.get( iblock );
+    if ( reader==nullptr ) {
+      reader = new larlite::storage_manager;
+      do_larlite_config( *reader, larlite_pset );
+      for ( auto const& larlitefile : fManagers["larlite"]->getBlockFiles( iblock ) )
+	reader->add_in_filename( larlitefile );
+      reader->open();
+      reader->enable_event_alignment(false);
+      fLarliteReaders.put( iblock, reader );
+    }
+    fLarliteReader = reader;
+    reader->go_to( larlite_entry( local_entry ), store );
+  }
+
+  uint32_t DataCoordinator::larlite_entry( Entry_t entry ) {
+    if ( entry<0 || entry>(Entry_t)UINT32_MAX ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " larlite entry " << entry << " cannot be addressed by storage_manager (32 bits)." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    return (uint32_t)entry;
+  }
+
+  void DataCoordinator::read_larcv( Entry_t entry ) {
+    if ( !fLazyLarcv ) {
+      larcv_io.read_entry( (size_t)entry );
+      return;
+    }
+    int iblock;
+    Entry_t local_entry;
+    if ( !fManagers["larcv"]->locate( entry, iblock, local_entry ) ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " larcv entry " << entry << " is not in the index." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    larcv::IOManager* reader = fLarcvReaders.get( iblock );
+    if ( reader==nullptr ) {
+      reader = new larcv::IOManager( larcv::IOManager::kREAD );
+      reader->configure( larcv_pset );
+      for ( auto const& larcvfile : fManagers["larcv"]->getBlockFiles( iblock ) )
+	reader->add_in_file( larcvfile );
+      reader->initialize();
+      fLarcvReaders.put( iblock, reader );
+    }
+    fLarcvReader = reader;
+    reader->read_entry( (size_t)local_entry );
+  }
+
+  void DataCoordinator::goto_entry( Entry_t entry, std::string ftype_driver ) {
+    int run, subrun, event;
+    Entry_t other_entry;
     fLastDriver = ftype_driver;
+    if ( fCostSidecar!="" ) stop_event_cost();
     if ( ftype_driver=="larlite" ) {
       if ( larlite_unused ) {
 	std::cout << "[larlite unused. goto_entry driven by larlite stopped.]" << std::endl;
 	return;
       }
-      larlite_io.go_to( entry );
+      read_larlite( entry, true );
       fManagers["larlite"]->getRSE( entry, run, subrun, event );
       if ( !larcv_unused ) {
 	fManagers["larcv"]->getEntry( run, subrun, event, other_entry );
 	// std::cout << "given larlite entry=" << entry  << " with "
 	// 	  << " rse=(" << run << ", " << subrun << ", " << event << ")"
 	// 	  << " corresponds to larcv entry=" << other_entry << std::endl;
-	larcv_io.read_entry( other_entry );
+	read_larcv( other_entry );
       }
     }
     else if ( ftype_driver=="larcv" ) {
@@ -283,14 +950,14 @@ namespace larlitecv {
 	std::cout << "[larcv unused. goto_entry driven by larcv stopped.]" << std::endl;
 	return;
       }
-      larcv_io.read_entry( entry );
+      read_larcv( entry );
       fManagers["larcv"]->getRSE( entry, run, subrun, event );
       if ( !larlite_unused ) {
 	fManagers["larlite"]->getEntry( run, subrun, event, other_entry );
 	// std::cout << "given larcv entry=" << entry  << " with "
 	// 	  << " rse=(" << run << ", " << subrun << ", " << event << ")"
 	// 	  << " corresponds to larlite entry=" << other_entry << std::endl;
-	larlite_io.go_to( other_entry, false );
+	read_larlite( other_entry, false );
       }
     }
     else {
@@ -300,76 +967,109 @@ namespace larlitecv {
     _current_run = run;
     _current_subrun = subrun;
     _current_event = event;
+    if ( fCostSidecar!="" ) start_event_cost( run, subrun, event );
   }
 
 
   void DataCoordinator::goto_event( int run, int subrun, int event, std::string ftype_driver ) {
-    int entry;
+    Entry_t entry;
     fLastDriver = ftype_driver;
+    if ( fCostSidecar!="" ) stop_event_cost();
     if ( !larlite_unused ) {
       fManagers["larlite"]->getEntry( run, subrun, event, entry );
-      larlite_io.go_to( entry, false );
+      read_larlite( entry, false );
       //larlite_io.set_id( run, subrun, event );
     }
     if ( !larcv_unused ) {
       fManagers["larcv"]->getEntry( run, subrun, event, entry );
-      larcv_io.read_entry( entry );
+      read_larcv( entry );
       //larcv_io.set_id( run, subrun, event );
     }
     _current_run = run;
     _current_subrun = subrun;
     _current_event = event;
+    if ( fCostSidecar!="" ) start_event_cost( run, subrun, event );
   }
 
-  int DataCoordinator::get_nentries( std::string ftype ) {
+  bool DataCoordinator::goto_next_ordered( std::string ftype_driver ) {
+    if ( fOrdered==nullptr || fOrderedDriver!=ftype_driver ) {
+      if ( fManagers.find( ftype_driver )==fManagers.end() ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " no index for driver '" << ftype_driver << "'" << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      delete fOrdered;
+      fOrdered = new RSEOrderedIterator( *fManagers[ftype_driver] );
+      fOrderedDriver = ftype_driver;
+      std::cout << "[DataCoordinator] " << ftype_driver << " entries in RSE order: merging " << fOrdered->nruns() << " sorted runs" << std::endl;
+    }
+    Entry_t entry;
+    if ( !fOrdered->next( entry ) ) return false;
+    goto_entry( entry, ftype_driver );
+    return true;
+  }
+
+  void DataCoordinator::reset_ordered() {
+    if ( fOrdered ) fOrdered->reset();
+  }
+
+  Entry_t DataCoordinator::get_nentries( std::string ftype ) {
     if ( fManagers.find(ftype)==fManagers.end() ) return 0;
     return fManagers[ftype]->nentries();
   }
 
+  const FileManager* DataCoordinator::get_filemanager( std::string ftype ) const {
+    auto iter = fManagers.find( ftype );
+    if ( iter==fManagers.end() ) return nullptr;
+    return iter->second;
+  }
+
   void DataCoordinator::save_entry() {
 
-    if ( !larcv_unused )  larcv_io.set_id( _current_run, _current_subrun, _current_event );
-    if ( !larlite_unused) larlite_io.set_id( _current_run, _current_subrun, _current_event );
+    if ( !larcv_unused )  fLarcvReader->set_id( _current_run, _current_subrun, _current_event );
+    if ( !larlite_unused) fLarliteReader->set_id( _current_run, _current_subrun, _current_event );
 
     if ( !larcv_unused )
-      larcv_io.save_entry();
+      fLarcvReader->save_entry();
     if ( !larlite_unused ) 
-      larlite_io.next_event(true);
+      fLarliteReader->next_event(true);
     // writing done implicitly when event changes for larlite storage_manager
+    fSavedRSE.push_back( RSE( _current_run, _current_subrun, _current_event ) );
+    if ( fRestoreListOrder ) fSavedListPos.push_back( fListPos );
   }
 
   void DataCoordinator::set_id( int run, int subrun, int event ) {
-    if ( !larcv_unused ) larcv_io.set_id( run, subrun, event );
-    if ( !larlite_unused )larlite_io.set_id( run, subrun, event );    
+    if ( !larcv_unused ) fLarcvReader->set_id( run, subrun, event );
+    if ( !larlite_unused )fLarliteReader->set_id( run, subrun, event );    
     _current_run    = run;
     _current_subrun = subrun;
     _current_event  = event;
   }
 
   int DataCoordinator::run() {
-    if ( fLastDriver=="larlite" ) return larlite_io.run_id();
-    else if ( fLastDriver=="larcv" ) return larcv_io.event_id().run();
+    if ( fLastDriver=="larlite" ) return fLarliteReader->run_id();
+    else if ( fLastDriver=="larcv" ) return fLarcvReader->event_id().run();
     return -1;
   }
 
   int DataCoordinator::subrun() {
-    if ( fLastDriver=="larlite" ) return larlite_io.subrun_id();
-    else if ( fLastDriver=="larcv" ) return larcv_io.event_id().subrun();
+    if ( fLastDriver=="larlite" ) return fLarliteReader->subrun_id();
+    else if ( fLastDriver=="larcv" ) return fLarcvReader->event_id().subrun();
     return -1;
   }
 
   int DataCoordinator::event() {
-    if ( fLastDriver=="larlite" ) return larlite_io.event_id();
-    else if ( fLastDriver=="larcv" ) return larcv_io.event_id().event();
+    if ( fLastDriver=="larlite" ) return fLarliteReader->event_id();
+    else if ( fLastDriver=="larcv" ) return fLarcvReader->event_id().event();
     return -1;
   }
 
   larlite::event_base* DataCoordinator::get_data( const larlite::data::DataType_t type, const std::string& name) {
-    return larlite_io.get_data( type, name );
+    return fLarliteReader->get_data( type, name );
   }
 
   larcv::EventBase* DataCoordinator::get_data( const larcv::ProductType_t type, const std::string& producer) {
-    return larcv_io.get_data( type, producer );
+    return fLarcvReader->get_data( type, producer );
   }
 
   void DataCoordinator::get_id( int& run, int& subrun, int& event ) {
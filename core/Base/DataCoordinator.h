@@ -2,6 +2,11 @@
 #define __DATA_COORDINATOR__
 
 #include "DataCoordinator.h"
+#include "FileManagerTypes.h"
+#include "EventCostTable.h"
+#include "EventMetadata.h"
+#include "ReaderCache.h"
+#include "RSEOrderedIterator.h"
 #include <string>
 #include <map>
 #include <vector>
@@ -35,8 +40,8 @@ namespace larlitecv {
 
   public:
     // get iomans
-    larlite::storage_manager& get_larlite_io() { return larlite_io; };
-    larcv::IOManager&         get_larcv_io()   { return larcv_io; };
+    larlite::storage_manager& get_larlite_io() { return *fLarliteReader; };
+    larcv::IOManager&         get_larcv_io()   { return *fLarcvReader; };
     void configure( std::string cfgfile, 
 		    std::string larlite_cfgname, 
 		    std::string larcv_cfgname, std::string coord_cfgname="DataCoordinator" );
@@ -51,13 +56,92 @@ namespace larlitecv {
     // set output files
     void set_outputfile( std::string filepath, std::string ftype );
 
+    // get the file indices from a node-local IndexDaemon (default: $LARLITECV_INDEXD_SOCKET, if set)
+    void set_index_daemon( std::string socketpath ) { fIndexDaemonSocket = socketpath; };
+
+    // reuse the index written to .pylardcache by an earlier job over the same filelist, as long as none of
+    // its files changed size or modification time since (default: on)
+    void use_index_cache( bool doit ) { fUseIndexCache = doit; };
+
+    // keep only the input files that hold one of the required products, e.g. require_product( "larlite", "mctruth", "generator" ).
+    // files with none of them are left out of the index and never opened. set before initialize.
+    void require_product( std::string ftype, std::string datatype, std::string producer );
+    // also require the configured read-only products: ReadOnlyDataTypes/ReadOnlyProducers (larlite)
+    // and ReadOnlyDataType/ReadOnlyDataName (larcv)
+    void prune_to_readonly_products( bool doit ) { fPruneToReadOnly = doit; };
+
+    // keep the entry/RSE tables in memory-mapped files in dir instead of on the heap (see FileManager::setOutOfCore)
+    void set_out_of_core_index( bool doit, std::string dir=".pylardcache" ) { fOutOfCoreIndex = doit; fOutOfCoreDir = dir; };
+
+    // open input files on demand: navigating to an entry opens only the file block holding it, and
+    // at most max_open blocks per file type stay open (least recently used are closed). applies to
+    // read-only file types; types that are written keep opening their whole list. set before initialize.
+    void set_lazy_open( bool doit, int max_open=4 ) { fLazyOpen = doit; fMaxOpenBlocks = max_open; };
+
+    // process only shard ishard of nshards. shards are cut along file boundaries of the driver's index
+    // and only the files of this shard are opened. entries are then numbered within the shard.
+    // a shard left without files (more shards than blocks) opens nothing and has no entries.
+    void set_shard( int ishard, int nshards, std::string ftype_driver="larcv" );
+
+    // process only the events of runs run_lo..run_hi, or of one subrun. the indices keep only the file
+    // blocks holding them, so no other file is opened, and get_selection() lists the driver's entries
+    // to visit (empty without a selection). set before initialize.
+    void select_runs( int run_lo, int run_hi, std::string ftype_driver="larcv" );
+    void select_subrun( int run, int subrun, std::string ftype_driver="larcv" );
+    const std::vector<EntryRange>& get_selection() const { return fSelection; };
+
+    // reprocess a list of events: a text file with one "run subrun event" per line ('#' starts a comment).
+    // the events are looked up in the driver's index, only the file blocks holding them are kept, and
+    // goto_next_listed() visits them in entry order: file by file, front to back within each file.
+    // with restore_order, the output files are rewritten at finalize so that saved events follow
+    // the order of the list. if no listed event is found nothing is opened and goto_next_listed()
+    // returns false at once. set before initialize.
+    void set_event_list( std::string listfile, std::string ftype_driver="larcv", bool restore_order=false );
+    bool goto_next_listed(); ///< false once every listed event has been visited
+    int64_t get_list_position() const { return fListPos; }; ///< line of the current event among the list's events, from 0
+    size_t get_list_size() const { return fListed.size(); };
+
+    // select events with a metadata sidecar (see EventMetadata) instead of a list file: the events
+    // passing every cut become the event list, so only the files holding them are opened
+    // (none, if no event passes). set before initialize.
+    void select_by_metadata( std::string sidecar, const std::vector<MetadataCut>& cuts, std::string ftype_driver="larcv" );
+
+    // checkpoint and resume. every `every` committed entries the outputs are closed off as a segment, and
+    // the progress, the segments and the registered seeds are written to checkpoint_file (atomically).
+    // if that file exists at initialize, the job resumes: seeds are restored and resume_entry() is the
+    // first entry still to do. finalize merges the segments into the requested output files and
+    // removes the checkpoint. set (and register seeds) before initialize.
+    //   for ( Entry_t entry=dataco.resume_entry(); entry<nentries; entry++ ) { ...; dataco.commit_entry( entry ); }
+    void set_checkpoint( std::string checkpoint_file, Entry_t every=1000 );
+    void register_seed( std::string name, int64_t* seed ) { fSeeds[name] = seed; };
+    void commit_entry( Entry_t entry ); ///< entry is done, and saved if it was to be. may write a checkpoint
+    void checkpoint();                  ///< close the current output segment and write a checkpoint now
+    Entry_t resume_entry() const { return fResumeEntry; };
+
+    // event processing costs. record: time from one goto_entry/goto_event to the next is stored per RSE
+    // and written to the sidecar at finalize. use: shards (and ParallelEventLoop/PreforkEventLoop chunks)
+    // are balanced by the recorded times instead of by number of entries.
+    void record_event_costs( std::string sidecar );
+    void use_event_costs( std::string sidecar );
+    const std::string& get_cost_sidecar() const { return fCostSidecar; };
+    const EventCostTable& get_event_costs() const { return fPlanningCosts; };
+
     // nentries
-    int get_nentries( std::string ftype );
+    Entry_t get_nentries( std::string ftype );
+
+    // index for a file type (nullptr before initialize/initialize_index)
+    const FileManager* get_filemanager( std::string ftype ) const;
 
     // navigation
-    void goto_entry( int entry, std::string ftype );
+    void goto_entry( Entry_t entry, std::string ftype );
     void goto_event( int run, int subrun, int event, std::string ftype_driver );
 
+    // run-ordered processing: go to the entry with the next higher (run, subrun, event) in the driver's
+    // index. false once every entry has been visited. reset_ordered() starts over.
+    //   while ( dataco.goto_next_ordered( "larcv" ) ) { ... }
+    bool goto_next_ordered( std::string ftype_driver );
+    void reset_ordered();
+
     // get/set id
     void set_id( int run, int subrun, int event );
     int run();
@@ -70,6 +154,13 @@ namespace larlitecv {
 
     // load after specifying files
     void initialize();
+    void initialize_index(); ///< only build the file indices, do not open any files for reading/writing
+    void share_index( const DataCoordinator& source ); ///< use the (already built) indices of source instead of building our own. source must outlive us.
+    std::string get_outputfile( std::string ftype ) const; ///< output file for ftype, from set_outputfile or the configuration. empty if ftype is not written.
+    void set_read_only(); ///< file types configured for writing become read-only (IOMode 0), and no outputs are set. set before initialize.
+    const larcv::PSet& get_larlite_pset() const { return larlite_pset; };
+    const larcv::PSet& get_larcv_pset() const { return larcv_pset; };
+    static larcv::PSet with_iomode( const larcv::PSet& pset, int iomode ); ///< copy of pset with its IOMode replaced
     void finalize();
     void close();
 
@@ -87,16 +178,103 @@ namespace larlitecv {
     
     std::vector< std::string > fManagerList;
     std::map< std::string, FileManager* > fManagers;
+    bool fOwnsManagers;
+    bool fIndexReady;
+    bool fEmptySelection; ///< the selection left no entries: open_io opens nothing
     bool fInit;
 
     std::map< std::string, std::vector<std::string> > user_filepaths;
     std::map< std::string, std::string > user_filelists;
     std::map< std::string, std::string > user_outpath;
+    std::string fIndexDaemonSocket;
+    bool fUseIndexCache;
+    std::map< std::string, std::vector<std::string> > fRequiredTrees;
+    bool fPruneToReadOnly;
+    std::vector<std::string> readonly_trees( std::string ftype );
+    bool fOutOfCoreIndex;
+    std::string fOutOfCoreDir;
     void prepfilelists();
 
+    // sharding
+    int fShardIndex;
+    int fNumShards;
+    std::string fShardDriver;
+    void apply_shard();
+
+    // run/subrun selection
+    bool fSelectRSE;
+    RSE fSelectLo;
+    RSE fSelectHi;
+    std::string fSelectDriver;
+    std::vector<EntryRange> fSelection;
+    void apply_selection();
+
+    // event list
+    std::string fEventListFile;
+    std::string fMetadataFile;
+    std::vector<MetadataCut> fMetadataCuts;
+    std::string fEventListDriver;
+    bool fRestoreListOrder;
+    std::vector< std::pair<Entry_t,int64_t> > fListed; ///< (driver entry, position in the list), in entry order
+    size_t fListCursor;
+    int64_t fListPos;
+    std::vector< int64_t > fSavedListPos; ///< list position of every saved entry
+    void apply_event_list();
+    void restore_list_order();
+    void open_io();  ///< configure the IO managers and open the inputs (and outputs)
+    void close_io(); ///< close them, and write the index summaries of the outputs
+    void open_larlite(); ///< configure larlite_io and open its inputs and output
+    void open_larcv();
+
+    // checkpointing
+    std::string fCheckpointFile;
+    Entry_t fCheckpointEvery;
+    Entry_t fResumeEntry;  ///< first uncommitted entry when the job started
+    Entry_t fNextEntry;    ///< first uncommitted entry
+    Entry_t fUncommitted;  ///< entries committed since the last checkpoint
+    int fSegment;          ///< output segment being written
+    std::map< std::string, std::string > fFinalOutputs;          ///< output file asked for, per file type
+    std::map< std::string, std::vector<std::string> > fSegments; ///< closed output segments, per file type
+    std::map< std::string, int64_t* > fSeeds;
+    void load_checkpoint();
+    void write_checkpoint();
+    void start_segment();
+    void finish_checkpoints();
+
+    // event costs
+    std::string fCostSidecar;
+    EventCostTable fRecordedCosts;
+    EventCostTable fPlanningCosts;
+    bool fCostPending;
+    RSE fCostRSE;
+    double fCostStart;
+    void start_event_cost( int run, int subrun, int event );
+    void stop_event_cost();
+
+    // ordered iteration
+    RSEOrderedIterator* fOrdered;
+    std::string fOrderedDriver;
+
+    // RSE of every saved entry. written into the output files at finalize (see IndexSummary)
+    RSElist fSavedRSE;
+    void write_index_summaries();
+
     // storage managers
     larlite::storage_manager larlite_io;
     larcv::IOManager         larcv_io;
+    larlite::storage_manager* fLarliteReader; ///< reader of the current entry: larlite_io, or one from fLarliteReaders
+    larcv::IOManager*         fLarcvReader;
+
+    // lazy opening
+    bool fLazyOpen;
+    int fMaxOpenBlocks;
+    bool fLazyLarlite;
+    bool fLazyLarcv;
+    ReaderCache< larlite::storage_manager > fLarliteReaders;
+    ReaderCache< larcv::IOManager >         fLarcvReaders;
+    void read_larlite( Entry_t entry, bool store );
+    void read_larcv( Entry_t entry );
+    static uint32_t larlite_entry( Entry_t entry ); ///< entry as storage_manager takes it. throws past 32 bits
     std::map< std::string, std::string > user_ioconfig;
     std::map< std::string, int > fIOmodes;
     std::string fLastDriver;
@@ -0,0 +1,111 @@
+#include "EventCostTable.h"
+#include "FileManager.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+
+namespace larlitecv {
+
+  bool EventCostTable::load( std::string sidecar ) {
+    std::ifstream infile( sidecar.c_str() );
+    if ( !infile.good() ) return false;
+    std::string line;
+    while ( std::getline( infile, line ) ) {
+      if ( line=="" || line[0]=='#' ) continue;
+      std::stringstream ss( line );
+      int run, subrun, event;
+      float seconds;
+      if ( ss >> run >> subrun >> event >> seconds )
+	fCosts[ RSE(run,subrun,event) ] = seconds;
+    }
+    return true;
+  }
+
+  bool EventCostTable::save( std::string sidecar ) const {
+    // write next to the target and rename, so readers never see a half-written sidecar
+    std::stringstream tmpname;
+    tmpname << sidecar << ".tmp" << getpid();
+    std::ofstream outfile( tmpname.str().c_str() );
+    if ( !outfile.good() ) return false;
+    outfile << "# run subrun event seconds\n";
+    for ( auto const& iter : fCosts )
+      outfile << iter.first.run << " " << iter.first.subrun << " " << iter.first.event << " " << iter.second << "\n";
+    outfile.close();
+    if ( outfile.fail() ) return false;
+    return std::rename( tmpname.str().c_str(), sidecar.c_str() )==0;
+  }
+
+  bool EventCostTable::merge_files( const std::vector<std::string>& inputs, std::string target ) {
+    EventCostTable merged;
+    merged.load( target );
+    for ( auto const& input : inputs ) merged.load( input );
+    if ( !merged.save( target ) ) return false;
+    for ( auto const& input : inputs ) std::remove( input.c_str() );
+    return true;
+  }
+
+  float EventCostTable::cost( const RSE& rse, float unknown ) const {
+    auto iter = fCosts.find( rse );
+    if ( iter==fCosts.end() ) return unknown;
+    return iter->second;
+  }
+
+  double EventCostTable::mean() const {
+    if ( fCosts.empty() ) return 0.;
+    double total = 0.;
+    for ( auto const& iter : fCosts ) total += iter.second;
+    return total/fCosts.size();
+  }
+
+  std::vector<double> EventCostTable::entry_costs( const FileManager& fman ) const {
+    float unknown = ( fCosts.empty() ) ? 1.0f : (float)mean();
+    std::vector<double> costs;
+    costs.reserve( fman.nentries() );
+    for ( int64_t irange=0; irange<fman.nranges(); irange++ ) {
+      const RSERange& range = fman.range( irange );
+      for ( Entry_t entry=range.first_entry; entry<range.first_entry+range.nentries; entry++ )
+	costs.push_back( cost( range.at( entry ), unknown ) );
+    }
+    return costs;
+  }
+
+  std::vector<double> EventCostTable::block_costs( const FileManager& fman ) const {
+    double unknown = ( fCosts.empty() ) ? 1.0 : mean();
+    const std::vector<FileBlock>& blocks = fman.get_fileblocks();
+    std::vector<double> costs( blocks.size(), 0. );
+    // ranges and blocks are both in entry order. a range can run on into the next block.
+    size_t iblock = 0;
+    for ( int64_t irange=0; irange<fman.nranges(); irange++ ) {
+      const RSERange& range = fman.range( irange );
+      Entry_t start = range.first_entry;
+      Entry_t end   = range.first_entry+range.nentries;
+      while ( start<end && iblock<blocks.size() ) {
+	Entry_t block_end = blocks[iblock].first_entry+blocks[iblock].nentries;
+	if ( start>=block_end ) {
+	  iblock++;
+	  continue;
+	}
+	Entry_t piece_end = std::min( end, block_end );
+	costs[iblock] += range_cost( range, start, piece_end, unknown );
+	start = piece_end;
+      }
+    }
+    return costs;
+  }
+
+  double EventCostTable::range_cost( const RSERange& range, Entry_t start, Entry_t end, double unknown ) const {
+    // the recorded events of the range sit together in the table
+    RSE last = range.at( end-1 );
+    double total = 0.;
+    Entry_t nfound = 0;
+    for ( auto iter=fCosts.lower_bound( range.at( start ) ); iter!=fCosts.end() && !( last<iter->first ); ++iter ) {
+      if ( iter->first.subevent!=range.subevent ) continue;
+      total += iter->second;
+      nfound++;
+    }
+    return total + unknown*(double)( end-start-nfound );
+  }
+
+}
@@ -0,0 +1,53 @@
+#ifndef __EVENT_COST_TABLE__
+#define __EVENT_COST_TABLE__
+
+#include <string>
+#include <vector>
+#include <map>
+#include "FileManagerTypes.h"
+
+namespace larlitecv {
+
+  class FileManager;
+
+  // Processing time per event, keyed by (run, subrun, event).
+  //
+  // DataCoordinator fills one while running (see DataCoordinator::record_event_costs) and writes it
+  // to a sidecar text file, one "run subrun event seconds" line per event. A later run reads the
+  // sidecar back so that ShardPlanner can cut shards and chunks of equal time rather than equal entries.
+  class EventCostTable {
+
+  public:
+
+    EventCostTable() {};
+    virtual ~EventCostTable() {};
+
+    bool load( std::string sidecar );  ///< adds the sidecar's costs to the table (overwriting). false if it cannot be read.
+    bool save( std::string sidecar ) const; ///< writes the whole table, via a temporary file and rename
+    void record( const RSE& rse, float seconds ) { fCosts[rse] = seconds; };
+    void clear() { fCosts.clear(); };
+
+    size_t size() const { return fCosts.size(); };
+    float cost( const RSE& rse, float unknown ) const; ///< seconds for rse, unknown if it was never recorded
+    double mean() const;
+
+    /// combine sidecars written by parallel workers into target (keeping what target already holds). inputs are deleted.
+    static bool merge_files( const std::vector<std::string>& inputs, std::string target );
+
+    /// cost of every entry of fman, in entry order. unrecorded entries get the mean cost (1 if the table is empty).
+    std::vector<double> entry_costs( const FileManager& fman ) const;
+
+    /// total cost of each file block of fman, as above. walks the index ranges, not the entries.
+    std::vector<double> block_costs( const FileManager& fman ) const;
+
+  protected:
+
+    /// total cost of entries [start,end) of range
+    double range_cost( const RSERange& range, Entry_t start, Entry_t end, double unknown ) const;
+
+    std::map< RSE, float > fCosts;
+  };
+
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "EventMetadata.h"
+#include "DataCoordinator.h"
+#include "FileManager.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <iterator>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+#include <unistd.h>
+
+namespace larlitecv {
+
+  // sidecar layout (host byte order):
+  //   char[8] magic | uint64 nrows | uint32 ncolumns | ncolumns x ( uint32 len | chars )
+  //   | int32 run[nrows] | int32 subrun[nrows] | int32 event[nrows] | int32 subevent[nrows] | ncolumns x double[nrows]
+  static const char kMetadataMagic[8] = { 'L','L','C','V','M','E','T','1' };
+
+  void EventMetadata::add_column( std::string name ) {
+    if ( !fRSE.empty() ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " cannot add column '" << name << "' to a filled table" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    fNames.push_back( name );
+    fColumns.push_back( std::vector<double>() );
+  }
+
+  void EventMetadata::fill( const RSE& rse, const std::vector<double>& values ) {
+    if ( values.size()!=fColumns.size() ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " got " << values.size() << " values for " << fColumns.size() << " columns" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    fRSE.push_back( rse );
+    for ( size_t icol=0; icol<values.size(); icol++ ) fColumns[icol].push_back( values[icol] );
+  }
+
+  void EventMetadata::clear() {
+    fNames.clear();
+    fColumns.clear();
+    fRSE.clear();
+  }
+
+  const std::vector<double>& EventMetadata::column( std::string name ) const {
+    for ( size_t icol=0; icol<fNames.size(); icol++ ) {
+      if ( fNames[icol]==name ) return fColumns[icol];
+    }
+    std::stringstream ss;
+    ss << __FILE__ << ":" << __LINE__ << " no metadata column '" << name << "'" << std::endl;
+    throw std::runtime_error( ss.str() );
+  }
+
+  std::vector<RSE> EventMetadata::select( const std::vector<MetadataCut>& cuts ) const {
+    // one pass over each cut's column
+    size_t nrows = fRSE.size();
+    std::vector<uint8_t> pass( nrows, 1 );
+    for ( auto const& cut : cuts ) {
+      const double* values = column( cut.column ).data();
+      const double lo = cut.min, hi = cut.max;
+      uint8_t* p = pass.data();
+      for ( size_t irow=0; irow<nrows; irow++ )
+	p[irow] &= (uint8_t)( ( values[irow]>lo ) & ( values[irow]<hi ) );
+    }
+    std::vector<RSE> selected;
+    for ( size_t irow=0; irow<nrows; irow++ ) {
+      if ( pass[irow] ) selected.push_back( fRSE[irow] );
+    }
+    return selected;
+  }
+
+  bool EventMetadata::save( std::string sidecar ) const {
+    std::string buffer( kMetadataMagic, sizeof(kMetadataMagic) );
+    uint64_t nrows = fRSE.size();
+    uint32_t ncolumns = (uint32_t)fNames.size();
+    buffer.append( (const char*)&nrows, sizeof(nrows) );
+    buffer.append( (const char*)&ncolumns, sizeof(ncolumns) );
+    for ( auto const& name : fNames ) {
+      uint32_t len = (uint32_t)name.size();
+      buffer.append( (const char*)&len, sizeof(len) );
+      buffer.append( name );
+    }
+    std::vector<int32_t> ids( nrows );
+    for ( size_t irow=0; irow<nrows; irow++ ) ids[irow] = fRSE[irow].run;
+    buffer.append( (const char*)ids.data(), nrows*sizeof(int32_t) );
+    for ( size_t irow=0; irow<nrows; irow++ ) ids[irow] = fRSE[irow].subrun;
+    buffer.append( (const char*)ids.data(), nrows*sizeof(int32_t) );
+    for ( size_t irow=0; irow<nrows; irow++ ) ids[irow] = fRSE[irow].event;
+    buffer.append( (const char*)ids.data(), nrows*sizeof(int32_t) );
+    for ( size_t irow=0; irow<nrows; irow++ ) ids[irow] = fRSE[irow].subevent;
+    buffer.append( (const char*)ids.data(), nrows*sizeof(int32_t) );
+    for ( auto const& values : fColumns )
+      buffer.append( (const char*)values.data(), nrows*sizeof(double) );
+
+    // write next to the target and rename, so readers never see a half-written sidecar
+    std::stringstream tmpname;
+    tmpname << sidecar << ".tmp" << getpid();
+    std::ofstream out( tmpname.str().c_str(), std::ios::binary );
+    if ( !out.good() ) return false;
+    out.write( buffer.data(), buffer.size() );
+    out.close();
+    if ( out.fail() || std::rename( tmpname.str().c_str(), sidecar.c_str() )!=0 ) {
+      std::remove( tmpname.str().c_str() );
+      return false;
+    }
+    return true;
+  }
+
+  bool EventMetadata::load( std::string sidecar ) {
+    std::ifstream in( sidecar.c_str(), std::ios::binary );
+    if ( !in.good() ) return false;
+    std::string buffer( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+    in.close();
+
+    uint64_t nrows = 0;
+    uint32_t ncolumns = 0;
+    size_t pos = sizeof(kMetadataMagic);
+    if ( buffer.size()<pos+sizeof(nrows)+sizeof(ncolumns) || memcmp( buffer.data(), kMetadataMagic, sizeof(kMetadataMagic) )!=0 )
+      return false;
+    memcpy( &nrows, buffer.data()+pos, sizeof(nrows) );
+    pos += sizeof(nrows);
+    memcpy( &ncolumns, buffer.data()+pos, sizeof(ncolumns) );
+    pos += sizeof(ncolumns);
+
+    std::vector<std::string> names;
+    for ( uint32_t icol=0; icol<ncolumns; icol++ ) {
+      uint32_t len = 0;
+      if ( pos+sizeof(len)>buffer.size() ) return false;
+      memcpy( &len, buffer.data()+pos, sizeof(len) );
+      pos += sizeof(len);
+      if ( pos+len>buffer.size() ) return false;
+      names.push_back( buffer.substr( pos, len ) );
+      pos += len;
+    }
+    if ( buffer.size()-pos != nrows*( 4*sizeof(int32_t)+ncolumns*sizeof(double) ) ) return false;
+
+    clear();
+    fNames = names;
+    std::vector<int32_t> ids[4];
+    for ( int iid=0; iid<4; iid++ ) {
+      ids[iid].resize( nrows );
+      memcpy( ids[iid].data(), buffer.data()+pos, nrows*sizeof(int32_t) );
+      pos += nrows*sizeof(int32_t);
+    }
+    fRSE.reserve( nrows );
+    for ( size_t irow=0; irow<nrows; irow++ ) fRSE.push_back( RSE( ids[0][irow], ids[1][irow], ids[2][irow], ids[3][irow] ) );
+    fColumns.resize( ncolumns );
+    for ( uint32_t icol=0; icol<ncolumns; icol++ ) {
+      fColumns[icol].resize( nrows );
+      memcpy( fColumns[icol].data(), buffer.data()+pos, nrows*sizeof(double) );
+      pos += nrows*sizeof(double);
+    }
+    return true;
+  }
+
+  EventMetadata EventMetadata::extract( DataCoordinator& dataco, std::string ftype,
+					const std::vector< std::pair< std::string, Extractor_t > >& extractors ) {
+    EventMetadata table;
+    for ( auto const& extractor : extractors ) table.add_column( extractor.first );
+
+    const FileManager* fman = dataco.get_filemanager( ftype );
+    if ( fman==nullptr ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " no index for '" << ftype << "'" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    std::vector<double> values( extractors.size() );
+    for ( Entry_t entry=0; entry<fman->nentries(); entry++ ) {
+      dataco.goto_entry( entry, ftype );
+      for ( size_t icol=0; icol<extractors.size(); icol++ ) values[icol] = extractors[icol].second( dataco );
+      table.fill( fman->getRSE( entry ), values );
+    }
+    std::cout << "[EventMetadata] extracted " << extractors.size() << " columns for " << table.size() << " " << ftype << " entries" << std::endl;
+    return table;
+  }
+
+}
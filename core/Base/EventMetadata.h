@@ -0,0 +1,66 @@
+#ifndef __EVENT_METADATA__
+#define __EVENT_METADATA__
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "FileManagerTypes.h"
+
+namespace larlitecv {
+
+  class DataCoordinator;
+
+  // a cut on one metadata column: passes if min < value < max
+  struct MetadataCut {
+    std::string column;
+    double min;
+    double max;
+    MetadataCut() : column(""), min(0), max(0) {};
+    MetadataCut( std::string c, double lo, double hi ) : column(c), min(lo), max(hi) {};
+  };
+
+  // A few scalars per event (neutrino energy, interaction mode, vertex, ...), stored column by column.
+  //
+  // extract() visits every entry of one file type once and fills the columns from user-supplied
+  // functions, and save() writes them to a compact binary sidecar. A later job loads the sidecar and
+  // select()s the events passing its cuts without opening any event file; see
+  // DataCoordinator::select_by_metadata. Rows are kept in the index's entry order and carry their
+  // (run, subrun, event), so the sidecar stays valid when a job shards or restricts its index.
+  class EventMetadata {
+
+  public:
+
+    /// computes one column's value for the current entry of dataco. return NaN if it is not defined: NaN fails every cut.
+    typedef std::function< double( DataCoordinator& dataco ) > Extractor_t;
+
+    EventMetadata() {};
+    virtual ~EventMetadata() {};
+
+    void add_column( std::string name ); ///< only while the table is empty
+    void fill( const RSE& rse, const std::vector<double>& values ); ///< one value per column, in column order
+    void clear();
+
+    size_t size() const { return fRSE.size(); };
+    const std::vector<std::string>& column_names() const { return fNames; };
+    const std::vector<double>& column( std::string name ) const; ///< throws if there is no such column
+    const std::vector<RSE>& rse() const { return fRSE; };
+
+    std::vector<RSE> select( const std::vector<MetadataCut>& cuts ) const; ///< events passing every cut, in row order
+
+    bool save( std::string sidecar ) const; ///< via a temporary file and rename
+    bool load( std::string sidecar );       ///< replaces the table. false if the sidecar cannot be read
+
+    /// visit every entry of ftype in dataco (which must be initialized) and fill one column per extractor
+    static EventMetadata extract( DataCoordinator& dataco, std::string ftype,
+				  const std::vector< std::pair< std::string, Extractor_t > >& extractors );
+
+  protected:
+
+    std::vector< std::string > fNames;
+    std::vector< std::vector<double> > fColumns;
+    std::vector< RSE > fRSE;
+  };
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "FileManager.h"
+#include "IndexDaemon.h"
 #include "Hashlib2plus/hashlibpp.h"
 #include <fstream>
 #include <iostream>
@@ -6,8 +7,15 @@
 #include <assert.h>
 #include <stdexcept>
 #include <sstream>
-#include "TFile.h"
-#include "TTree.h"
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iterator>
+#include <climits>
 
 namespace larlitecv {
 
@@ -15,6 +23,21 @@ namespace larlitecv {
     isParsed = false;
     fFilelist = filelist;
     fUseCache = use_cache;
+    fLoadedFromCache = false;
+    fDaemonSocket = "";
+    fTableRanges = nullptr;
+    fTableOrder = nullptr;
+    fTableMaxEnd = nullptr;
+    fTableNRanges = 0;
+    fNEntries = 0;
+    fOutOfCore = false;
+    fOutOfCoreDir = ".pylardcache";
+    fMapAddr = nullptr;
+    fMapSize = 0;
+  }
+
+  FileManager::~FileManager() {
+    unmap_table();
   }
 
   void FileManager::initialize() {
@@ -26,21 +49,31 @@ namespace larlitecv {
 
     sortRSE( false );
 
-    fFilelistHash = get_filelisthash();
+    fFilelistHash = get_indexhash();
     std::cout << "Hash: " << fFilelistHash << std::endl;
 
-    //if ( fUseCache && cacheExists(fFilelistHash) ) {
-    if ( fUseCache && false ) {
-      // not implemented yet
-      load_from_cache(fFilelistHash);
+    if ( fDaemonSocket!="" && load_from_daemon() ) {
+      // index served by the node-local daemon
+      return;
+    }
+
+    if ( fUseCache && load_from_cache(fFilelistHash) ) {
+      // index from an earlier job over the same, unchanged files: no file was opened
+      fLoadedFromCache = true;
+      std::cout << "[FileManager] loaded " << filetype() << " index from " << cachefile( fFilelistHash ) << ": "
+		<< ffinallist.size() << " files, " << nentries() << " entries." << std::endl;
     }
     else {
       // we need to build this instance up
       std::vector<std::string> files;
       parse_filelist(files);   ///< get a vector of string with the filelist
       if ( files.size()>0 ) {
-	      user_build_index(files,ffinallist,frse2entry,fentry2rse); ///< goes to concrete class function to build event index
-	      cache_index( fFilelistHash );
+	      user_build_index(files,ffinallist,fentry2rse,fblocks,ffileinfo); ///< goes to concrete class function to build event index
+	      build_lookup();
+	      std::cout << "[FileManager] " << filetype() << " index: " << nentries() << " entries in "
+			<< fTableNRanges << " ranges, " << index_memory() << " bytes in memory." << std::endl;
+	      report_duplicates();
+	      if ( fUseCache ) cache_index( fFilelistHash );
       }
       else {
         throw std::runtime_error("FileManager::initialize[error]. File list is empty.");
@@ -83,55 +116,340 @@ namespace larlitecv {
     return hash;
   }
   
+  std::string FileManager::get_indexhash() {
+    // a pruned index is a different index: the required trees become part of its label
+    std::string hash = get_filelisthash();
+    if ( frequiredtrees.empty() ) return hash;
+    std::string label = hash;
+    for ( auto const& tree : frequiredtrees ) label += ":"+tree;
+    hashwrapper *myWrapper = new md5wrapper();
+    hash = myWrapper->getHashFromString( label );
+    delete myWrapper;
+    return hash;
+  }
+
+  bool FileManager::has_required_tree( const std::set<std::string>& trees ) const {
+    if ( frequiredtrees.empty() ) return true;
+    for ( auto const& tree : trees ) {
+      if ( frequiredtrees.find( tree )!=frequiredtrees.end() ) return true;
+    }
+    return false;
+  }
+
+  Entry_t FileManager::assign_subevents( std::vector<RSE>& entries, std::vector< std::pair<RSEKey,Entry_t> >& scratch ) {
+    // sort (key, position) pairs: repeats of an RSE end up next to each other, in file order.
+    // the first copy keeps subevent 0, later copies get 1, 2, ...
+    scratch.resize( entries.size() );
+    for ( size_t i=0; i<entries.size(); i++ ) scratch[i] = std::make_pair( entries[i].key(), (Entry_t)i );
+    std::sort( scratch.begin(), scratch.end() );
+    Entry_t nrepeats = 0;
+    int subevent = 0;
+    for ( size_t i=1; i<scratch.size(); i++ ) {
+      if ( scratch[i].first==scratch[i-1].first ) {
+	entries[ scratch[i].second ].subevent = ++subevent;
+	nrepeats++;
+      }
+      else subevent = 0;
+    }
+    return nrepeats;
+  }
+
+  Entry_t FileManager::findDuplicates( std::vector< std::pair<Entry_t,Entry_t> >* examples, size_t maxexamples ) const {
+    // ranges of the same run, subrun and subevent sorted by first event. a range starting before the
+    // furthest end seen so far in its group repeats events of an earlier range: the one reaching
+    // that end covers every event up to it.
+    std::vector< int64_t > order( fTableNRanges );
+    for ( int64_t i=0; i<fTableNRanges; i++ ) order[i] = i;
+    const RSERange* ranges = fTableRanges;
+    std::sort( order.begin(), order.end(), [ranges]( int64_t a, int64_t b ) {
+	const RSERange& ra = ranges[a];
+	const RSERange& rb = ranges[b];
+	if ( ra.run!=rb.run ) return ra.run<rb.run;
+	if ( ra.subrun!=rb.subrun ) return ra.subrun<rb.subrun;
+	if ( ra.subevent!=rb.subevent ) return ra.subevent<rb.subevent;
+	if ( ra.first_event!=rb.first_event ) return ra.first_event<rb.first_event;
+	return ra.first_entry<rb.first_entry;
+      } );
+
+    if ( examples ) examples->clear();
+    Entry_t nduplicates = 0;
+    int64_t reach = -1; // range with the furthest end in the current group
+    for ( size_t i=0; i<order.size(); i++ ) {
+      const RSERange& range = ranges[order[i]];
+      if ( reach>=0 ) {
+	const RSERange& prev = ranges[reach];
+	if ( prev.run==range.run && prev.subrun==range.subrun && prev.subevent==range.subevent ) {
+	  int64_t prevend = (int64_t)prev.first_event+prev.nentries;
+	  int64_t end     = (int64_t)range.first_event+range.nentries;
+	  if ( range.first_event<prevend ) {
+	    nduplicates += std::min( prevend, end )-range.first_event;
+	    if ( examples && examples->size()<maxexamples ) {
+	      Entry_t copy = prev.first_entry+( range.first_event-prev.first_event );
+	      examples->push_back( std::make_pair( std::min( copy, range.first_entry ), std::max( copy, range.first_entry ) ) );
+	    }
+	  }
+	  if ( end<=prevend ) continue;
+	}
+      }
+      reach = order[i];
+    }
+    return nduplicates;
+  }
+
+  void FileManager::report_duplicates() {
+    std::vector< std::pair<Entry_t,Entry_t> > examples;
+    Entry_t nduplicates = findDuplicates( &examples );
+    if ( nduplicates==0 ) return;
+    std::cout << "[FileManager] " << filetype() << ": " << nduplicates << " events appear in more than one file. "
+	      << "goto_event goes to the first copy." << std::endl;
+    for ( auto const& example : examples ) {
+      int run, subrun, event;
+      getRSE( example.first, run, subrun, event );
+      int first_block  = getFileBlock( example.first );
+      int second_block = getFileBlock( example.second );
+      std::cout << "  (" << run << "," << subrun << "," << event << ") entries " << example.first << " and " << example.second
+		<< ": " << ffinallist[ fblocks[first_block].first_file ] << ", " << ffinallist[ fblocks[second_block].first_file ] << std::endl;
+    }
+  }
+
+  std::string FileManager::cachefile( std::string hash ) {
+    return ".pylardcache/"+hash+"_"+filetype()+".idx";
+  }
+
+  bool FileManager::stat_file( const std::string& path, int64_t& size, int64_t& mtime ) {
+    struct stat info;
+    if ( stat( path.c_str(), &info )!=0 ) return false;
+    size  = (int64_t)info.st_size;
+    mtime = (int64_t)info.st_mtime;
+    return true;
+  }
+
+  // index cache layout: char[8] magic | uint32 ninputs | ninputs x ( uint32 len | chars | int64 size | int64 mtime )
+  //   | serialized index (see serialize_index)
+  // every file of the filelist is stamped, not only those that made it into the index: a change to
+  // any of them could change the index.
+  static const char kCacheMagic[8] = { 'L','L','C','V','C','C','H','1' };
+
   void FileManager::cache_index( std::string hash ) {
     int err = system("mkdir -p .pylardcache");
     if ( err!=0 ) {
       std::cout << "Could not make cache folder .pylardcache" << std::endl;
-      assert(false);
-    }
-    std::string cachefile = ".pylardcache/"+hash+".root";
-    TFile rcache( cachefile.c_str(), "recreate" );
-    TTree tcache("entry2rse","RSE to entry map");
-    int run, subrun, event;
-    tcache.Branch("run",&run,"run/I");
-    tcache.Branch("subrun",&subrun,"subrun/I");
-    tcache.Branch("event",&event,"event/I");
-    int nentries = (int)fentry2rse.size();
-    for (int entry=0; entry<nentries; entry++) {
-      auto iter = fentry2rse.find(entry);
-      if ( iter==fentry2rse.end() ) {
-	std::stringstream ss;
-	ss << __FILE__ << ":" << __LINE__ << " could not find entry #" << entry << " in fentry2rse." << std::endl;
-	throw std::runtime_error( ss.str() );
+      return;
+    }
+    std::vector<std::string> inputs;
+    parse_filelist( inputs );
+
+    std::string buffer( kCacheMagic, sizeof(kCacheMagic) );
+    uint32_t ninputs = (uint32_t)inputs.size();
+    buffer.append( (const char*)&ninputs, sizeof(ninputs) );
+    for ( auto const& input : inputs ) {
+      int64_t stamp[2] = { -1, -1 };
+      stat_file( input, stamp[0], stamp[1] );
+      uint32_t len = (uint32_t)input.size();
+      buffer.append( (const char*)&len, sizeof(len) );
+      buffer.append( input );
+      buffer.append( (const char*)stamp, sizeof(stamp) );
+    }
+    std::string index;
+    serialize_index( index );
+    buffer.append( index );
+
+    // write next to the target and rename, so concurrent jobs never read a half-written cache
+    std::stringstream tmpname;
+    tmpname << cachefile( hash ) << ".tmp" << getpid();
+    std::ofstream out( tmpname.str().c_str(), std::ios::binary );
+    out.write( buffer.data(), buffer.size() );
+    out.close();
+    if ( out.fail() || std::rename( tmpname.str().c_str(), cachefile( hash ).c_str() )!=0 ) {
+      std::cout << "[FileManager] could not write index cache " << cachefile( hash ) << std::endl;
+      std::remove( tmpname.str().c_str() );
+    }
+  }
+
+  bool FileManager::load_from_cache( std::string hash ) {
+    std::ifstream in( cachefile( hash ).c_str(), std::ios::binary );
+    if ( !in.good() ) return false;
+    std::string buffer( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+    in.close();
+
+    size_t pos = 0;
+    if ( buffer.size()<sizeof(kCacheMagic)+sizeof(uint32_t) || memcmp( buffer.data(), kCacheMagic, sizeof(kCacheMagic) )!=0 )
+      return false;
+    pos += sizeof(kCacheMagic);
+
+    // the filelist (same hash) must still stamp the same as when the cache was written
+    std::vector<std::string> inputs;
+    parse_filelist( inputs );
+    uint32_t ninputs = 0;
+    memcpy( &ninputs, buffer.data()+pos, sizeof(ninputs) );
+    pos += sizeof(ninputs);
+    if ( ninputs!=inputs.size() ) return false;
+    for ( uint32_t iinput=0; iinput<ninputs; iinput++ ) {
+      uint32_t len = 0;
+      if ( pos+sizeof(len)>buffer.size() ) return false;
+      memcpy( &len, buffer.data()+pos, sizeof(len) );
+      pos += sizeof(len);
+      int64_t stamp[2];
+      if ( pos+len+sizeof(stamp)>buffer.size() ) return false;
+      if ( buffer.compare( pos, len, inputs[iinput] )!=0 ) return false;
+      pos += len;
+      memcpy( stamp, buffer.data()+pos, sizeof(stamp) );
+      pos += sizeof(stamp);
+      int64_t size, mtime;
+      if ( !stat_file( inputs[iinput], size, mtime ) || size!=stamp[0] || mtime!=stamp[1] ) {
+	std::cout << "[FileManager] " << inputs[iinput] << " changed since the index was cached. Rebuilding." << std::endl;
+	return false;
       }
-      const RSE& rse = iter->second;
-      run = rse.run;
-      subrun = rse.subrun;
-      event = rse.event;
-      tcache.Fill();
     }
-    //tcache.Write();
-    rcache.Write();
+
+    return deserialize_index( buffer.substr( pos ) );
+  }
+
+  bool FileManager::load_from_daemon() {
+    // ask the daemon for the index. any failure means we fall back to building it in-process.
+    std::string buffer;
+    IndexClient client( fDaemonSocket );
+    std::vector<std::string> required( frequiredtrees.begin(), frequiredtrees.end() );
+    if ( !client.request_index( filetype(), fFilelist, required, buffer ) ) {
+      std::cout << "[FileManager] index daemon at " << fDaemonSocket << " unavailable (" << client.last_error() << "). "
+		<< "Building index in-process." << std::endl;
+      return false;
+    }
+    if ( !deserialize_index( buffer ) ) {
+      std::cout << "[FileManager] could not unpack index from daemon. Building index in-process." << std::endl;
+      return false;
+    }
+    std::cout << "[FileManager] loaded " << filetype() << " index from daemon: " << ffinallist.size() << " files, "
+	      << nentries() << " entries." << std::endl;
+    return true;
+  }
+
+  // serialized index layout (host byte order, only ever shared on the same machine):
+  //   char[8] magic | uint32 nfiles | nfiles x ( uint32 len | chars ) | uint64 nranges | nranges x RSERange
+  //   | uint32 nblocks | nblocks x int64[4] (first_entry,nentries,first_file,nfiles)
+  //   | nfiles x ( int64[3] (nentries,size,mtime) | uint32 ntrees | ntrees x ( uint32 len | chars ) )
+  static const char kIndexMagic[8] = { 'L','L','C','V','I','D','X','5' };
+
+  static void append_string( std::string& buffer, const std::string& str ) {
+    uint32_t len = (uint32_t)str.size();
+    buffer.append( (const char*)&len, sizeof(len) );
+    buffer.append( str );
+  }
+
+  static bool read_string( const std::string& buffer, size_t& pos, std::string& str ) {
+    uint32_t len = 0;
+    if ( pos+sizeof(len)>buffer.size() ) return false;
+    memcpy( &len, buffer.data()+pos, sizeof(len) );
+    pos += sizeof(len);
+    if ( pos+len>buffer.size() ) return false;
+    str = buffer.substr( pos, len );
+    pos += len;
+    return true;
+  }
+
+  void FileManager::serialize_index( std::string& buffer ) const {
+    buffer.clear();
+    buffer.append( kIndexMagic, sizeof(kIndexMagic) );
+    uint32_t nfiles = (uint32_t)ffinallist.size();
+    buffer.append( (const char*)&nfiles, sizeof(nfiles) );
+    for ( auto const& fpath : ffinallist ) append_string( buffer, fpath );
+    uint64_t nranges = (uint64_t)fTableNRanges;
+    buffer.append( (const char*)&nranges, sizeof(nranges) );
+    if ( nranges>0 )
+      buffer.append( (const char*)fTableRanges, nranges*sizeof(RSERange) );
+    uint32_t nblocks = (uint32_t)fblocks.size();
+    buffer.append( (const char*)&nblocks, sizeof(nblocks) );
+    for ( auto const& block : fblocks ) {
+      int64_t b[4] = { block.first_entry, block.nentries, block.first_file, block.nfiles };
+      buffer.append( (const char*)b, sizeof(b) );
+    }
+    for ( size_t ifile=0; ifile<ffinallist.size(); ifile++ ) {
+      FileInfo info = ( ifile<ffileinfo.size() ) ? ffileinfo[ifile] : FileInfo();
+      int64_t f[3] = { info.nentries, info.size, info.mtime };
+      buffer.append( (const char*)f, sizeof(f) );
+      uint32_t ntrees = (uint32_t)info.trees.size();
+      buffer.append( (const char*)&ntrees, sizeof(ntrees) );
+      for ( auto const& tree : info.trees ) append_string( buffer, tree );
+    }
   }
 
-  void FileManager::load_from_cache( std::string hash ) {
-    std::string cachefile = ".pylardcache/"+hash+".root";
-    TFile rcache( cachefile.c_str(), "open" );
-    TTree* tcache = (TTree*)rcache.Get("entry2rse");
-    int run, subrun, event;
-    tcache->SetBranchAddress("run",&run);
-    tcache->SetBranchAddress("subrun",&subrun);
-    tcache->SetBranchAddress("event",&event);
-    ULong_t entry=0;
-    long bytes = tcache->GetEntry(entry);
-    while (bytes>0) {
-      frse2entry.insert( std::pair< RSE, int>( RSE(run, subrun, event), (int)entry ) );
-      fentry2rse.insert( std::pair< int, RSE>( (int)entry, RSE(run, subrun, event) ) );
-      bytes = tcache->GetEntry(entry);
-      entry++;
+  bool FileManager::deserialize_index( const std::string& buffer ) {
+    size_t pos = 0;
+    if ( buffer.size()<sizeof(kIndexMagic) || memcmp( buffer.data(), kIndexMagic, sizeof(kIndexMagic) )!=0 )
+      return false;
+    pos += sizeof(kIndexMagic);
+
+    std::vector<std::string> finallist;
+    uint32_t nfiles = 0;
+    if ( pos+sizeof(nfiles)>buffer.size() ) return false;
+    memcpy( &nfiles, buffer.data()+pos, sizeof(nfiles) );
+    pos += sizeof(nfiles);
+    for ( uint32_t ifile=0; ifile<nfiles; ifile++ ) {
+      std::string fpath;
+      if ( !read_string( buffer, pos, fpath ) ) return false;
+      finallist.push_back( fpath );
     }
-    tcache->Write();
-    rcache.Close();
+
+    uint64_t nranges = 0;
+    if ( pos+sizeof(nranges)>buffer.size() ) return false;
+    memcpy( &nranges, buffer.data()+pos, sizeof(nranges) );
+    pos += sizeof(nranges);
+    if ( nranges>(buffer.size()-pos)/sizeof(RSERange) ) return false;
+    std::vector<RSERange> ranges( nranges );
+    if ( nranges>0 )
+      memcpy( ranges.data(), buffer.data()+pos, nranges*sizeof(RSERange) );
+    pos += nranges*sizeof(RSERange);
+    Entry_t nentries = 0;
+    for ( auto const& range : ranges ) {
+      if ( range.first_entry!=nentries || range.nentries<=0 ) return false;
+      nentries += range.nentries;
+    }
+
+    uint32_t nblocks = 0;
+    if ( pos+sizeof(nblocks)>buffer.size() ) return false;
+    memcpy( &nblocks, buffer.data()+pos, sizeof(nblocks) );
+    pos += sizeof(nblocks);
+    if ( pos+nblocks*4*sizeof(int64_t)>buffer.size() ) return false;
+    // blocks must tile the entries in order and point at files of the list
+    std::vector<FileBlock> blocks;
+    Entry_t nblocked = 0;
+    for ( uint32_t iblock=0; iblock<nblocks; iblock++ ) {
+      int64_t b[4];
+      memcpy( b, buffer.data()+pos, sizeof(b) );
+      pos += sizeof(b);
+      if ( b[0]!=nblocked || b[1]<0 || b[1]>nentries-nblocked ) return false;
+      if ( b[2]<0 || b[3]<0 || b[2]>(int64_t)nfiles || b[3]>(int64_t)nfiles-b[2] ) return false;
+      nblocked += b[1];
+      blocks.push_back( FileBlock( b[0], b[1], (int)b[2], (int)b[3] ) );
+    }
+    if ( nblocked!=nentries ) return false;
+
+    std::vector<FileInfo> fileinfo( nfiles );
+    for ( auto& info : fileinfo ) {
+      int64_t f[3];
+      uint32_t ntrees = 0;
+      if ( pos+sizeof(f)+sizeof(ntrees)>buffer.size() ) return false;
+      memcpy( f, buffer.data()+pos, sizeof(f) );
+      pos += sizeof(f);
+      memcpy( &ntrees, buffer.data()+pos, sizeof(ntrees) );
+      pos += sizeof(ntrees);
+      info.nentries = f[0];
+      info.size     = f[1];
+      info.mtime    = f[2];
+      if ( ntrees>(buffer.size()-pos)/sizeof(uint32_t) ) return false; // each name takes at least its length
+      info.trees.resize( ntrees );
+      for ( auto& tree : info.trees ) {
+	if ( !read_string( buffer, pos, tree ) ) return false;
+      }
+    }
+    if ( pos!=buffer.size() ) return false;
+
+    ffinallist = finallist;
+    fentry2rse.set_ranges( ranges );
+    fblocks = blocks;
+    ffileinfo = fileinfo;
+    build_lookup();
+    return true;
   }
 
   std::string FileManager::printset( const std::set< std::string >& myset ) {
@@ -142,23 +460,313 @@ namespace larlitecv {
     return yo;
   }
 
-  void FileManager::getRSE( int entry, int& run, int& subrun, int& event ) const {
+  // one summary element per kSummaryStride ranges: a lookup touches the summary, then a single
+  // stride-sized window of the (possibly mapped) table.
+  static const int64_t kSummaryStride = 1024;
+
+  void FileManager::build_lookup() {
+    // ranges sorted by their first RSE. a lookup binary searches for the last range starting at
+    // or before the RSE, then steps back only while earlier ranges still reach that far, which
+    // is a single step unless ranges overlap (repeated events).
+    unmap_table();
+    const std::vector<RSERange>& ranges = fentry2rse.ranges();
+    frangeorder.resize( ranges.size() );
+    for ( size_t irange=0; irange<ranges.size(); irange++ ) frangeorder[irange] = (int64_t)irange;
+    std::sort( frangeorder.begin(), frangeorder.end(), [&ranges]( int64_t a, int64_t b ) {
+	RSEKey ka = ranges[a].first().key();
+	RSEKey kb = ranges[b].first().key();
+	if ( ka==kb ) return ranges[a].first_entry<ranges[b].first_entry;
+	return ka<kb;
+      } );
+    frangemaxend.resize( ranges.size() );
+    for ( size_t i=0; i<frangeorder.size(); i++ ) {
+      RSEKey end = ranges[frangeorder[i]].last().key();
+      frangemaxend[i] = ( i>0 && end<frangemaxend[i-1] ) ? frangemaxend[i-1] : end;
+    }
+
+    fNEntries = fentry2rse.size();
+    fTableNRanges = (int64_t)ranges.size();
+    if ( fOutOfCore && map_table( ranges ) ) {
+      // the mapped file now holds the table. free the heap copies.
+      std::vector< int64_t >().swap( frangeorder );
+      std::vector< RSEKey >().swap( frangemaxend );
+      fentry2rse = RSElist();
+    }
+    else {
+      fTableRanges = ranges.data();
+      fTableOrder  = frangeorder.data();
+      fTableMaxEnd = frangemaxend.data();
+    }
+
+    fSummaryEntry.clear();
+    fSummaryKey.clear();
+    for ( int64_t i=0; i<fTableNRanges; i+=kSummaryStride ) {
+      fSummaryEntry.push_back( fTableRanges[i].first_entry );
+      fSummaryKey.push_back( fTableRanges[ fTableOrder[i] ].first().key() );
+    }
+  }
+
+  // mapped table layout: char[8] magic | int64 nranges | RSERange[nranges] | int64 order[nranges] | RSEKey maxend[nranges]
+  static const char kTableMagic[8] = { 'L','L','C','V','T','A','B','1' };
+
+  bool FileManager::map_table( const std::vector<RSERange>& ranges ) {
+    int64_t nranges = (int64_t)ranges.size();
+    size_t header = sizeof(kTableMagic)+sizeof(int64_t);
+    size_t mapsize = header + nranges*( sizeof(RSERange)+sizeof(int64_t)+sizeof(RSEKey) );
+
+    std::string mkdir = "mkdir -p "+fOutOfCoreDir;
+    if ( system( mkdir.c_str() )!=0 ) {
+      std::cout << "[FileManager] could not make " << fOutOfCoreDir << ". Keeping index in memory." << std::endl;
+      return false;
+    }
+    std::string tmpl = fOutOfCoreDir+"/"+filetype()+"_index_XXXXXX";
+    std::vector<char> path( tmpl.begin(), tmpl.end() );
+    path.push_back( '\0' );
+    int fd = mkstemp( path.data() );
+    if ( fd<0 ) {
+      std::cout << "[FileManager] could not create index table in " << fOutOfCoreDir << ". Keeping index in memory." << std::endl;
+      return false;
+    }
+    unlink( path.data() ); // space is released when the last mapping goes away, including forked workers'
+
+    bool ok = true;
+    FILE* table = fdopen( fd, "wb" );
+    if ( table==NULL ) {
+      close( fd );
+      return false;
+    }
+    ok = ok && fwrite( kTableMagic, 1, sizeof(kTableMagic), table )==sizeof(kTableMagic);
+    ok = ok && fwrite( &nranges, sizeof(nranges), 1, table )==1;
+    if ( nranges>0 ) {
+      ok = ok && fwrite( ranges.data(), sizeof(RSERange), nranges, table )==(size_t)nranges;
+      ok = ok && fwrite( frangeorder.data(), sizeof(int64_t), nranges, table )==(size_t)nranges;
+      ok = ok && fwrite( frangemaxend.data(), sizeof(RSEKey), nranges, table )==(size_t)nranges;
+    }
+    ok = ( fflush( table )==0 ) && ok;
+
+    void* addr = MAP_FAILED;
+    if ( ok ) addr = mmap( NULL, mapsize, PROT_READ, MAP_SHARED, fileno(table), 0 );
+    fclose( table ); // the mapping keeps the file alive
+    if ( addr==MAP_FAILED ) {
+      std::cout << "[FileManager] could not map index table. Keeping index in memory." << std::endl;
+      return false;
+    }
+
+    fMapAddr = addr;
+    fMapSize = mapsize;
+    const char* base = (const char*)addr + header;
+    fTableRanges = (const RSERange*)base;
+    fTableOrder  = (const int64_t*)( base + nranges*sizeof(RSERange) );
+    fTableMaxEnd = (const RSEKey*)( base + nranges*( sizeof(RSERange)+sizeof(int64_t) ) );
+    std::cout << "[FileManager] " << filetype() << " index table mapped (" << mapsize << " bytes)." << std::endl;
+    return true;
+  }
+
+  void FileManager::unmap_table() {
+    if ( fMapAddr!=nullptr ) munmap( fMapAddr, fMapSize );
+    fMapAddr = nullptr;
+    fMapSize = 0;
+  }
+
+  RSElist FileManager::table_list() const {
+    if ( fMapAddr==nullptr ) return fentry2rse;
+    RSElist list;
+    list.set_ranges( std::vector<RSERange>( fTableRanges, fTableRanges+fTableNRanges ) );
+    return list;
+  }
+
+  size_t FileManager::index_memory() const {
+    size_t bytes = fentry2rse.ranges().capacity()*sizeof(RSERange)
+      + frangeorder.capacity()*sizeof(int64_t) + frangemaxend.capacity()*sizeof(RSEKey)
+      + fSummaryEntry.capacity()*sizeof(Entry_t) + fSummaryKey.capacity()*sizeof(RSEKey)
+      + fblocks.capacity()*sizeof(FileBlock);
+    return bytes;
+  }
+
+  int64_t FileManager::table_findRange( Entry_t entry ) const {
+    if ( entry<0 || entry>=fNEntries ) return -1;
+    // last summary element at or before entry, then the last range in its window at or before entry
+    int64_t isummary = (int64_t)( std::upper_bound( fSummaryEntry.begin(), fSummaryEntry.end(), entry )-fSummaryEntry.begin() )-1;
+    const RSERange* lo = fTableRanges + isummary*kSummaryStride;
+    const RSERange* hi = fTableRanges + std::min( (isummary+1)*kSummaryStride, fTableNRanges );
+    const RSERange* iter = std::upper_bound( lo, hi, entry, []( Entry_t e, const RSERange& r ) { return e<r.first_entry; } );
+    return (int64_t)( iter-fTableRanges )-1;
+  }
+
+  void FileManager::getRSE( Entry_t entry, int& run, int& subrun, int& event ) const {
     run =  subrun = event = 0;
-    if ( fentry2rse.find( entry )!=fentry2rse.end() ) {
-      auto iter = fentry2rse.find( entry );
-      run    = iter->second.run;
-      subrun = iter->second.subrun;
-      event  = iter->second.event;
+    int64_t irange = table_findRange( entry );
+    if ( irange>=0 ) {
+      RSE rse = fTableRanges[irange].at( entry );
+      run    = rse.run;
+      subrun = rse.subrun;
+      event  = rse.event;
+    }
+  }
+
+  RSE FileManager::getRSE( Entry_t entry ) const {
+    int64_t irange = table_findRange( entry );
+    if ( irange<0 ) return RSE( 0, 0, 0 );
+    return fTableRanges[irange].at( entry );
+  }
+
+  Entry_t FileManager::findEntry( const RSE& rse ) const {
+    // for a repeated RSE, the lowest entry is returned
+    if ( fTableNRanges==0 ) return -1;
+    RSEKey key = rse.key();
+    int64_t isummary = (int64_t)( std::upper_bound( fSummaryKey.begin(), fSummaryKey.end(), key )-fSummaryKey.begin() )-1;
+    if ( isummary<0 ) return -1;
+    const int64_t* lo = fTableOrder + isummary*kSummaryStride;
+    const int64_t* hi = fTableOrder + std::min( (isummary+1)*kSummaryStride, fTableNRanges );
+    const RSERange* ranges = fTableRanges;
+    const int64_t* iter = std::upper_bound( lo, hi, key, [ranges]( const RSEKey& k, int64_t irange ) {
+	return k<ranges[irange].first().key();
+      } );
+    Entry_t found = -1;
+    for ( int64_t i=(int64_t)( iter-fTableOrder )-1; i>=0 && !( fTableMaxEnd[i]<key ); i-- ) {
+      const RSERange& range = ranges[fTableOrder[i]];
+      if ( !range.contains( rse ) ) continue;
+      Entry_t entry = range.first_entry + ( rse.event-range.first_event );
+      if ( found<0 || entry<found ) found = entry;
+    }
+    return found;
+  }
+
+  std::vector<EntryRange> FileManager::findEntryRanges( const RSE& lo, const RSE& hi ) const {
+    // candidates start at or below hi (a prefix of the sorted order) and reach lo or above
+    // (a suffix, as the running maximum end only grows)
+    std::vector<EntryRange> found;
+    RSEKey klo = lo.key();
+    RSEKey khi = hi.key();
+    if ( fTableNRanges==0 || khi<klo ) return found;
+    const RSERange* ranges = fTableRanges;
+    int64_t ifirst = std::lower_bound( fTableMaxEnd, fTableMaxEnd+fTableNRanges, klo )-fTableMaxEnd;
+    const int64_t* first = fTableOrder+ifirst;
+    const int64_t* last  = std::upper_bound( fTableOrder, fTableOrder+fTableNRanges, khi, [ranges]( const RSEKey& k, int64_t irange ) {
+	return k<ranges[irange].first().key();
+      } );
+    for ( const int64_t* iter=first; iter<last; iter++ ) {
+      const RSERange& range = ranges[*iter];
+      if ( range.last().key()<klo ) continue;
+      // keys grow with the event number inside a range: bisect for the part within [lo,hi]
+      Entry_t a = 0, b = range.nentries;
+      while ( a<b ) {
+	Entry_t mid = (a+b)/2;
+	if ( range.at( range.first_entry+mid ).key()<klo ) a = mid+1;
+	else b = mid;
+      }
+      Entry_t start = a;
+      b = range.nentries;
+      while ( a<b ) {
+	Entry_t mid = (a+b)/2;
+	if ( khi<range.at( range.first_entry+mid ).key() ) b = mid;
+	else a = mid+1;
+      }
+      if ( start<a ) found.push_back( EntryRange( range.first_entry+start, range.first_entry+a ) );
+    }
+
+    std::sort( found.begin(), found.end(), []( const EntryRange& x, const EntryRange& y ) { return x.start<y.start; } );
+    std::vector<EntryRange> merged;
+    for ( auto const& r : found ) {
+      if ( !merged.empty() && r.start<=merged.back().end ) merged.back().end = std::max( merged.back().end, r.end );
+      else merged.push_back( r );
+    }
+    return merged;
+  }
+
+  std::vector<EntryRange> FileManager::findRuns( int run_lo, int run_hi ) const {
+    return findEntryRanges( RSE( run_lo, INT_MIN, INT_MIN, INT_MIN ), RSE( run_hi, INT_MAX, INT_MAX, INT_MAX ) );
+  }
+
+  std::vector<EntryRange> FileManager::findSubrun( int run, int subrun ) const {
+    return findEntryRanges( RSE( run, subrun, INT_MIN, INT_MIN ), RSE( run, subrun, INT_MAX, INT_MAX ) );
+  }
+
+  std::vector<int> FileManager::getBlocksOf( const std::vector<EntryRange>& entries ) const {
+    std::vector<int> blocks;
+    for ( auto const& r : entries ) {
+      if ( r.end<=r.start ) continue;
+      int ifirst = getFileBlock( r.start );
+      int ilast  = getFileBlock( r.end-1 );
+      if ( ifirst<0 || ilast<0 ) continue;
+      for ( int iblock=ifirst; iblock<=ilast; iblock++ ) {
+	if ( blocks.empty() || blocks.back()<iblock ) blocks.push_back( iblock );
+      }
+    }
+    return blocks;
+  }
+
+  int FileManager::getFileBlock( Entry_t entry ) const {
+    // blocks are stored in entry order
+    int lo = 0;
+    int hi = (int)fblocks.size()-1;
+    while ( lo<=hi ) {
+      int mid = (lo+hi)/2;
+      const FileBlock& block = fblocks[mid];
+      if ( entry<block.first_entry ) hi = mid-1;
+      else if ( entry>=block.first_entry+block.nentries ) lo = mid+1;
+      else return mid;
     }
+    return -1;
   }
 
-  void FileManager::getEntry( int run, int subrun, int event, int& entry ) const {
-    entry = 0;
-    RSE rse(run,subrun,event);
-    auto iter = frse2entry.find( rse );
-    if ( iter!=frse2entry.end() ) {
-      entry = iter->second;
+  bool FileManager::locate( Entry_t entry, int& iblock, Entry_t& local_entry ) const {
+    // every file of a block holds the block's events in the same order
+    iblock = getFileBlock( entry );
+    if ( iblock<0 ) {
+      local_entry = -1;
+      return false;
     }
+    local_entry = entry - fblocks[iblock].first_entry;
+    return true;
+  }
+
+  std::vector<std::string> FileManager::getBlockFiles( int iblock ) const {
+    std::vector<std::string> files;
+    if ( iblock<0 || iblock>=(int)fblocks.size() ) return files;
+    const FileBlock& block = fblocks[iblock];
+    files.assign( ffinallist.begin()+block.first_file, ffinallist.begin()+block.first_file+block.nfiles );
+    return files;
+  }
+
+  void FileManager::append_block( const RSElist& rselist, int first_file, int nfiles,
+				  RSElist& entry2rse, std::vector<FileBlock>& fileblocks ) {
+    fileblocks.push_back( FileBlock( entry2rse.size(), rselist.size(), first_file, nfiles ) );
+    entry2rse.append( rselist );
+  }
+
+  void FileManager::restrict_to_blocks( const std::vector<int>& blocks ) {
+    std::vector< std::string > finallist;
+    RSElist entry2rse;
+    std::vector< FileBlock > fileblocks;
+    std::vector< FileInfo > fileinfo;
+    RSElist full = table_list();
+
+    for ( auto const& iblock : blocks ) {
+      if ( iblock<0 || iblock>=(int)fblocks.size() ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " file block #" << iblock << " does not exist." << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      const FileBlock& block = fblocks[iblock];
+      int first_file = (int)finallist.size();
+      for ( int ifile=block.first_file; ifile<block.first_file+block.nfiles; ifile++ ) {
+	finallist.push_back( ffinallist[ifile] );
+	fileinfo.push_back( ( ifile<(int)ffileinfo.size() ) ? ffileinfo[ifile] : FileInfo() );
+      }
+      append_block( full.sublist( block.first_entry, block.nentries ), first_file, block.nfiles, entry2rse, fileblocks );
+    }
+
+    std::swap( ffinallist, finallist );
+    std::swap( fentry2rse, entry2rse );
+    std::swap( fblocks, fileblocks );
+    std::swap( ffileinfo, fileinfo );
+    build_lookup();
+  }
+
+  void FileManager::getEntry( int run, int subrun, int event, Entry_t& entry ) const {
+    entry = findEntry( RSE(run,subrun,event) );
+    if ( entry<0 ) entry = 0;
   }
     
   
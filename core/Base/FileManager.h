@@ -17,41 +17,111 @@ namespace larlitecv {
     
   public:
     FileManager( std::string filelist, bool use_cache=true );
-    virtual ~FileManager() {};
+    virtual ~FileManager();
+    FileManager( const FileManager& ) = delete; ///< the table view points into our own storage
+    FileManager& operator=( const FileManager& ) = delete;
 
     void setFilelist( std::string flist ) { fFilelist = flist; };
     virtual std::string filetype()=0; //< return name of filetype (e.g. larlite, larcv)
     void initialize();
-    void getRSE( int entry, int& run, int& subrun, int& event ) const;
-    void getEntry( int run, int subrun, int event, int& entry ) const;
+    void getRSE( Entry_t entry, int& run, int& subrun, int& event ) const;
+    RSE getRSE( Entry_t entry ) const; ///< including its subevent. all zero if entry is not in the index
+    void getEntry( int run, int subrun, int event, Entry_t& entry ) const;
+    Entry_t findEntry( const RSE& rse ) const; ///< entry of rse, -1 if it is not in the index
+    std::vector<EntryRange> findEntryRanges( const RSE& lo, const RSE& hi ) const; ///< entries with lo <= RSE <= hi, as ascending, non-adjacent ranges
+    std::vector<EntryRange> findRuns( int run_lo, int run_hi ) const;   ///< every entry of runs run_lo..run_hi
+    std::vector<EntryRange> findSubrun( int run, int subrun ) const;    ///< every entry of one subrun
+    std::vector<int> getBlocksOf( const std::vector<EntryRange>& entries ) const; ///< file blocks holding these entries: the files to open for them
+    Entry_t findDuplicates( std::vector< std::pair<Entry_t,Entry_t> >* examples=nullptr, size_t maxexamples=5 ) const; ///< number of extra copies of events held by more than one file block. examples: (earlier, later) entry pairs
     const std::vector<std::string>& get_final_filelist() const { return ffinallist; };
-    int nentries() const { return frse2entry.size(); };
+    const std::vector<FileInfo>& get_fileinfo() const { return ffileinfo; }; ///< one per file of the final filelist
+    bool loaded_from_cache() const { return fLoadedFromCache; };
+    Entry_t nentries() const { return fNEntries; };
+    int64_t nranges() const { return fTableNRanges; };
+    const RSERange& range( int64_t irange ) const { return fTableRanges[irange]; }; ///< ranges are in entry order
+    const std::vector<FileBlock>& get_fileblocks() const { return fblocks; };
+    int getFileBlock( Entry_t entry ) const; ///< index of the file block holding entry, -1 if out of range
+    bool locate( Entry_t entry, int& iblock, Entry_t& local_entry ) const; ///< file block holding entry, and entry's number inside each of that block's files
+    std::vector<std::string> getBlockFiles( int iblock ) const; ///< files of a file block, in final filelist order
+    void restrict_to_blocks( const std::vector<int>& blocks ); ///< keep only these file blocks. entries are renumbered from zero.
+    /// adds the block of files [first_file,first_file+nfiles) holding rselist, after the entries already in entry2rse
+    static void append_block( const RSElist& rselist, int first_file, int nfiles, RSElist& entry2rse, std::vector<FileBlock>& fileblocks );
     void sortRSE( bool doit ) { m_sort_rse = doit; };
     bool isSorted() { return m_sort_rse; };
+    void setDaemonSocket( std::string socketpath ) { fDaemonSocket = socketpath; }; ///< ask an IndexDaemon for the index before building it ourselves
+
+    // keep only files holding at least one of these trees (e.g. "mctruth_generator_tree"). other files are
+    // dropped before the flavor logic runs, so they are never opened for reading. set before initialize.
+    void setRequiredTrees( const std::vector<std::string>& trees ) { frequiredtrees = std::set<std::string>( trees.begin(), trees.end() ); };
+    const std::set<std::string>& getRequiredTrees() const { return frequiredtrees; };
+
+    // out-of-core index: the range table is written to an unlinked file in dir and memory-mapped,
+    // so the kernel pages it in and out as needed. only a sparse summary (every 1024th range) stays
+    // on the heap. set before initialize.
+    void setOutOfCore( bool doit, std::string dir=".pylardcache" ) { fOutOfCore = doit; fOutOfCoreDir = dir; };
+    bool isOutOfCore() const { return fMapAddr!=nullptr; };
+    size_t index_memory() const; ///< heap bytes used by the entry/RSE tables (excludes the mapped file)
+
+    // flat representation of the index. used to pass it between processes (see IndexDaemon)
+    void serialize_index( std::string& buffer ) const;
+    bool deserialize_index( const std::string& buffer );
 
   protected:
     
     virtual void user_build_index( const std::vector<std::string>& input,
 				   std::vector<std::string>& finalfilelist,
-				   std::map< RSE, int >& rse2entry,
-				   std::map< int, RSE >& entry2fse ) = 0; ///< pure virtual function that exists frse2entry and fentry2fse are built
+				   RSElist& entry2rse,
+				   std::vector<FileBlock>& fileblocks,
+				   std::vector<FileInfo>& fileinfo ) = 0; ///< pure virtual function where the file list, entry to RSE list, file blocks and per-file info are built
     //virtual void user_build_index( const std::vector<std::string>& input ) = 0;
     void parse_filelist( std::vector<std::string>& flist);         ///< parses the filelist
     std::string get_filelisthash(); ///< create md5 hash from filelist contents
+    std::string get_indexhash();    ///< filelist hash, combined with the required trees if there are any
+    bool has_required_tree( const std::set<std::string>& trees ) const; ///< true if trees hold a required tree, or nothing is required
+    static Entry_t assign_subevents( std::vector<RSE>& entries, std::vector< std::pair<RSEKey,Entry_t> >& scratch ); ///< number repeats within a file. returns how many there were
+    void report_duplicates();
     //bool cacheExists( std::string hash ) { return false; };
-    void load_from_cache( std::string hash );
+    bool load_from_cache( std::string hash ); ///< false if there is no cache or any input file changed since it was written
     void cache_index( std::string hash );
+    std::string cachefile( std::string hash );
+    static bool stat_file( const std::string& path, int64_t& size, int64_t& mtime );
+    bool load_from_daemon();
     std::string printset( const std::set< std::string >& myset );
+    void build_lookup(); ///< builds the sorted lookup from fentry2rse, maps it if out-of-core, and points the table view at it
+    bool map_table( const std::vector<RSERange>& ranges ); ///< write table to an unlinked file and mmap it
+    void unmap_table();
+    RSElist table_list() const; ///< copy of the whole entry->RSE table
+    int64_t table_findRange( Entry_t entry ) const;
 
     bool fUseCache;
+    bool fLoadedFromCache;
+    std::set<std::string> frequiredtrees;
     bool isParsed;
     bool m_sort_rse;
     std::string fFilelist;
     std::string fFilelistHash;
+    std::string fDaemonSocket;
     
     std::vector< std::string > ffinallist;
-    std::map< RSE, int > frse2entry;
-    std::map< int, RSE > fentry2rse;
+    RSElist fentry2rse; ///< RSE of each entry, run-length encoded. emptied once the table is mapped
+    std::vector< int64_t > frangeorder; ///< indices of the ranges, sorted by first RSE
+    std::vector< RSEKey > frangemaxend; ///< running maximum of the ranges' last RSE, in frangeorder order
+    std::vector< FileBlock > fblocks;
+    std::vector< FileInfo > ffileinfo;
+
+    // the table used by all lookups: the vectors above, or the same arrays in the mapped file
+    const RSERange* fTableRanges;
+    const int64_t*  fTableOrder;
+    const RSEKey*   fTableMaxEnd;
+    int64_t fTableNRanges;
+    Entry_t fNEntries;
+    std::vector< Entry_t > fSummaryEntry; ///< first entry of every kSummaryStride-th range
+    std::vector< RSEKey >  fSummaryKey;   ///< first RSE of every kSummaryStride-th range in sorted order
+
+    bool fOutOfCore;
+    std::string fOutOfCoreDir;
+    void* fMapAddr;
+    size_t fMapSize;
 
   };
 
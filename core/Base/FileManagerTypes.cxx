@@ -1,4 +1,6 @@
 #include "FileManagerTypes.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace larlitecv {
 
@@ -12,4 +14,68 @@ namespace larlitecv {
     return (os << ss.str());
   };
 
+  void RSElist::push_back( const RSE& rse ) {
+    if ( !franges.empty() && franges.back().extends( rse ) )
+      franges.back().nentries++;
+    else
+      franges.push_back( RSERange( rse, fsize ) );
+    fsize++;
+  }
+
+  void RSElist::append( const RSElist& other ) {
+    for ( auto const& range : other.franges ) {
+      RSERange shifted = range;
+      shifted.first_entry = fsize;
+      if ( !franges.empty() && franges.back().extends( shifted.first() ) )
+	franges.back().nentries += shifted.nentries;
+      else
+	franges.push_back( shifted );
+      fsize += range.nentries;
+    }
+  }
+
+  RSElist RSElist::sublist( Entry_t start, Entry_t n ) const {
+    RSElist sub;
+    if ( n<=0 ) return sub;
+    int64_t irange = findRange( start );
+    if ( irange<0 ) return sub;
+    Entry_t end = start+n;
+    for ( ; irange<(int64_t)franges.size() && franges[irange].first_entry<end; irange++ ) {
+      const RSERange& range = franges[irange];
+      Entry_t lo = std::max( start, range.first_entry );
+      Entry_t hi = std::min( end, range.first_entry+range.nentries );
+      RSERange piece = range;
+      piece.first_event = range.first_event + (int)(lo-range.first_entry);
+      piece.first_entry = sub.fsize;
+      piece.nentries    = hi-lo;
+      sub.franges.push_back( piece );
+      sub.fsize += piece.nentries;
+    }
+    return sub;
+  }
+
+  int64_t RSElist::findRange( Entry_t entry ) const {
+    if ( entry<0 || entry>=fsize ) return -1;
+    // last range starting at or before entry
+    auto iter = std::upper_bound( franges.begin(), franges.end(), entry,
+				  []( Entry_t e, const RSERange& r ) { return e<r.first_entry; } );
+    return (int64_t)( iter-franges.begin() )-1;
+  }
+
+  RSE RSElist::at( Entry_t entry ) const {
+    int64_t irange = findRange( entry );
+    if ( irange<0 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " entry #" << entry << " not in list of " << fsize << " entries." << std::endl;
+      throw std::out_of_range( ss.str() );
+    }
+    return franges[irange].at( entry );
+  }
+
+  void RSElist::set_ranges( const std::vector<RSERange>& ranges ) {
+    franges = ranges;
+    fsize = 0;
+    for ( auto const& range : franges ) fsize += range.nentries;
+  }
+
 }
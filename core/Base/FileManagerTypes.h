@@ -7,52 +7,108 @@
 #include <set>
 #include <string>
 #include <sstream>
+#include <functional>
+#include <type_traits>
+#include <stdint.h>
 
 namespace larlitecv {
 
+  typedef int64_t Entry_t; ///< entry number in an index. combined datasets can exceed 2^31 entries.
+
+  class RSEKey;
+
+  // (run, subrun, event, subevent). a plain 16-byte value: arrays of RSE can be copied and
+  // written out with memcpy. comparisons go through the packed RSEKey.
   class RSE {
   public:
-    RSE() {}
-    RSE( int _run, int _subrun, int _event, int _subevent=0 ) {
-      run      = _run;
-      subrun   = _subrun;
-      event    = _event;
-      subevent = _subevent;
-    }
-    virtual ~RSE() {};
+    RSE() = default;
+    constexpr RSE( int _run, int _subrun, int _event, int _subevent=0 )
+      : run(_run), subrun(_subrun), event(_event), subevent(_subevent) {};
 
     int run;
     int subrun;
     int event;
     int subevent;
-    
-    // make comparison operators
-    bool operator<(const RSE &b) const {
-      if ( run<b.run ) return true;
-      else if ( run>b.run ) return false;
-      // run==b.run
-      if ( subrun<b.subrun ) return true;
-      else if ( subrun>b.subrun) return false;
-      //subrun==b.subrun
-      if ( event<b.event) return true;
-      else if ( event>b.event ) return false;
-      //event==b.event
-      if ( subevent<b.subevent) return true;
-      else if ( subevent>b.subevent ) return false;
-      return false;
-    };
 
+    constexpr RSEKey key() const;
+
+    // make comparison operators
+    bool operator<(const RSE &b) const;
     bool operator==(const RSE &b) const {
-      if ( run==b.run && subrun==b.subrun && event==b.event && subevent==b.subevent ) return true;
-      return false;
+      return run==b.run && subrun==b.subrun && event==b.event && subevent==b.subevent;
     };
 
     friend std::ostream& operator<<(std::ostream &os, RSE const& );
   };
-  
-  class RSElist : public std::vector< RSE > {
+
+  // Order-preserving 128-bit encoding of an RSE: hi = run:subrun, lo = event:subevent.
+  // Each field is stored with its sign bit flipped, so negative values sort before positive ones
+  // and comparing keys as unsigned integers gives the same order as comparing RSEs field by field.
+  class RSEKey {
+  public:
+    constexpr RSEKey() : hi(0), lo(0) {};
+    constexpr RSEKey( uint64_t _hi, uint64_t _lo ) : hi(_hi), lo(_lo) {};
+    constexpr RSEKey( const RSE& rse )
+      : hi( (bias(rse.run)<<32) | bias(rse.subrun) ), lo( (bias(rse.event)<<32) | bias(rse.subevent) ) {};
+
+    uint64_t hi;
+    uint64_t lo;
+
+    constexpr bool operator<( const RSEKey& b ) const  { return hi<b.hi || ( hi==b.hi && lo<b.lo ); };
+    constexpr bool operator==( const RSEKey& b ) const { return hi==b.hi && lo==b.lo; };
+    constexpr bool operator!=( const RSEKey& b ) const { return !( *this==b ); };
+    constexpr RSE rse() const { return RSE( unbias(hi>>32), unbias(hi), unbias(lo>>32), unbias(lo) ); };
+
+    static constexpr uint64_t bias( int v ) { return (uint64_t)( (uint32_t)v ^ 0x80000000u ); };
+    static constexpr int unbias( uint64_t v ) { return (int)(int32_t)( (uint32_t)v ^ 0x80000000u ); };
+  };
+
+  constexpr RSEKey RSE::key() const { return RSEKey( *this ); }
+  inline bool RSE::operator<(const RSE &b) const { return key()<b.key(); }
+
+  static_assert( sizeof(RSE)==4*sizeof(int32_t), "RSE is serialized as four int32s" );
+  static_assert( std::is_trivially_copyable<RSE>::value, "RSE must stay trivially copyable" );
+  static_assert( RSE(-1,0,0).key() < RSE(0,0,0).key() && RSE(1,2,3).key() < RSE(1,2,4).key(), "RSEKey must preserve RSE order" );
+
+  // Consecutive entries first_entry+i, i in [0,nentries), holding events
+  // (run, subrun, first_event+i, subevent). Files usually hold long runs of increasing events
+  // in one subrun, so a whole file is typically a handful of these.
+  class RSERange {
   public:
-    RSElist() 
+    RSERange() = default;
+    RSERange( const RSE& rse, Entry_t _first_entry )
+      : run(rse.run), subrun(rse.subrun), first_event(rse.event), subevent(rse.subevent), first_entry(_first_entry), nentries(1) {};
+
+    int run;
+    int subrun;
+    int first_event;
+    int subevent;
+    Entry_t first_entry;
+    Entry_t nentries;
+
+    RSE first() const { return RSE( run, subrun, first_event, subevent ); };
+    RSE last()  const { return RSE( run, subrun, first_event+(int)(nentries-1), subevent ); };
+    RSE at( Entry_t entry ) const { return RSE( run, subrun, first_event+(int)(entry-first_entry), subevent ); }; ///< entry must be inside the range
+    bool extends( const RSE& rse ) const { ///< true if rse is the next event of this range
+      return rse.run==run && rse.subrun==subrun && rse.subevent==subevent && rse.event==first_event+nentries;
+    };
+    bool contains( const RSE& rse ) const {
+      return rse.run==run && rse.subrun==subrun && rse.subevent==subevent
+	&& rse.event>=first_event && (Entry_t)rse.event-first_event<nentries;
+    };
+    bool operator==( const RSERange& b ) const {
+      return run==b.run && subrun==b.subrun && first_event==b.first_event && subevent==b.subevent
+	&& first_entry==b.first_entry && nentries==b.nentries;
+    };
+  };
+
+  static_assert( std::is_trivially_copyable<RSERange>::value && sizeof(RSERange)==32, "RSERange is serialized with memcpy" );
+
+  // Ordered list of RSEs, one per entry, stored as RSERanges. Appending an RSE that continues
+  // the last range only bumps its count, so memory scales with the number of ranges, not events.
+  class RSElist {
+  public:
+    RSElist() : fsize(0)
       {};
     virtual ~RSElist() {};
     bool operator<(const RSElist &b) const {
@@ -70,18 +126,75 @@ namespace larlitecv {
 	   && event()==b.event() ) return true;
       return false;      
     };
-    int run()    const { if (size()>0) return at(0).run;    return -1; };
-    int subrun() const { if (size()>0) return at(0).subrun; return -1; };
-    int event()  const { if (size()>0) return at(0).event;  return -1; };
-    bool isequal( const RSElist& b ) const {
-      if ( b.size()!=size() ) return false;
-      for (int irse=0;irse<(int)size(); irse++) {
-        if ( !(b.at(irse)==at(irse)) ) return false;
-      } 
-      return true;
-    };
+    int run()    const { if (size()>0) return franges.front().run;         return -1; };
+    int subrun() const { if (size()>0) return franges.front().subrun;      return -1; };
+    int event()  const { if (size()>0) return franges.front().first_event; return -1; };
+    bool isequal( const RSElist& b ) const { return fsize==b.fsize && franges==b.franges; }; ///< ranges are always merged, so equal lists have equal ranges
+
+    void push_back( const RSE& rse );
+    void append( const RSElist& other ); ///< add all of other's entries after ours
+    RSElist sublist( Entry_t start, Entry_t n ) const; ///< entries [start,start+n), renumbered from zero
+    RSE at( Entry_t entry ) const;           ///< O(log nranges). entry must be in [0,size())
+    int64_t findRange( Entry_t entry ) const; ///< index of the range holding entry, -1 if out of range
+    void clear() { franges.clear(); fsize = 0; };
+    Entry_t size() const { return fsize; };
+    bool empty() const { return fsize==0; };
+    const std::vector<RSERange>& ranges() const { return franges; };
+    void set_ranges( const std::vector<RSERange>& ranges ); ///< ranges must be contiguous from entry zero
+
+  protected:
+    std::vector<RSERange> franges;
+    Entry_t fsize;
+  };
+
+  // A group of files holding the same list of events, e.g. the larlite opreco and mcinfo files
+  // made from the same job. Entries [first_entry, first_entry+nentries) of the index live in
+  // files [first_file, first_file+nfiles) of the final filelist.
+  class FileBlock {
+  public:
+    FileBlock() : first_entry(0), nentries(0), first_file(0), nfiles(0) {};
+    FileBlock( Entry_t _first_entry, Entry_t _nentries, int _first_file, int _nfiles )
+      : first_entry(_first_entry), nentries(_nentries), first_file(_first_file), nfiles(_nfiles) {};
+
+    Entry_t first_entry;
+    Entry_t nentries;
+    int first_file;
+    int nfiles;
   };
 
+  // What the index pass learned about one file, so it need not be opened again to find out.
+  class FileInfo {
+  public:
+    FileInfo() : nentries(0), size(0), mtime(0) {};
+
+    Entry_t nentries;   ///< entries in the file's id tree
+    int64_t size;       ///< bytes on disk. size and mtime tell whether a cached index is still valid
+    int64_t mtime;
+    std::vector<std::string> trees; ///< names of the trees in the file
+  };
+
+  // entries [start,end) of an index
+  class EntryRange {
+  public:
+    EntryRange() : start(0), end(0) {};
+    EntryRange( Entry_t _start, Entry_t _end ) : start(_start), end(_end) {};
+    Entry_t start;
+    Entry_t end;
+  };
+
+}
+
+namespace std {
+  template<> struct hash< larlitecv::RSEKey > {
+    size_t operator()( const larlitecv::RSEKey& k ) const {
+      uint64_t h = k.hi*0x9E3779B97F4A7C15ULL;
+      h ^= k.lo + 0x632BE59BD9B4E019ULL + (h<<6) + (h>>2);
+      return (size_t)h;
+    }
+  };
+  template<> struct hash< larlitecv::RSE > {
+    size_t operator()( const larlitecv::RSE& rse ) const { return hash< larlitecv::RSEKey >()( rse.key() ); }
+  };
 }
 
 #endif
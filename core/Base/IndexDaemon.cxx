@@ -0,0 +1,373 @@
+#include "IndexDaemon.h"
+#include "FileManager.h"
+#include "LarliteFileManager.h"
+#include "LarcvFileManager.h"
+#include "Hashlib2plus/hashlibpp.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <stdint.h>
+#include <unistd.h>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace larlitecv {
+
+  // ---------------------------------------------------------------------
+  // framing
+
+  static bool write_all( int fd, const char* data, size_t len ) {
+    while ( len>0 ) {
+      ssize_t n = send( fd, data, len, MSG_NOSIGNAL );
+      if ( n<0 && errno==EINTR ) continue;
+      if ( n<=0 ) return false;
+      data += n;
+      len  -= (size_t)n;
+    }
+    return true;
+  }
+
+  static bool read_all( int fd, char* data, size_t len ) {
+    while ( len>0 ) {
+      ssize_t n = recv( fd, data, len, 0 );
+      if ( n<0 && errno==EINTR ) continue;
+      if ( n<=0 ) return false;
+      data += n;
+      len  -= (size_t)n;
+    }
+    return true;
+  }
+
+  bool send_message( int fd, const std::string& msg ) {
+    uint32_t len = (uint32_t)msg.size();
+    if ( !write_all( fd, (const char*)&len, sizeof(len) ) ) return false;
+    return write_all( fd, msg.data(), msg.size() );
+  }
+
+  bool recv_message( int fd, std::string& msg ) {
+    uint32_t len = 0;
+    if ( !read_all( fd, (char*)&len, sizeof(len) ) ) return false;
+    msg.resize( len );
+    if ( len==0 ) return true;
+    return read_all( fd, &msg[0], len );
+  }
+
+  bool set_timeouts( int fd, int seconds ) {
+    timeval tv;
+    tv.tv_sec  = seconds;
+    tv.tv_usec = 0;
+    return setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) )==0
+      && setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) )==0;
+  }
+
+  bool peer_is_same_user( int fd ) {
+#ifdef SO_PEERCRED
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if ( getsockopt( fd, SOL_SOCKET, SO_PEERCRED, &cred, &len )!=0 ) return false;
+    return cred.uid==geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if ( getpeereid( fd, &uid, &gid )!=0 ) return false;
+    return uid==geteuid();
+#endif
+  }
+
+  static bool make_address( const std::string& socketpath, sockaddr_un& addr ) {
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    if ( socketpath.size()>=sizeof(addr.sun_path) ) return false;
+    strncpy( addr.sun_path, socketpath.c_str(), sizeof(addr.sun_path)-1 );
+    return true;
+  }
+
+  // ---------------------------------------------------------------------
+  // daemon
+
+  IndexDaemon::IndexDaemon( std::string socketpath, size_t max_memory )
+    : fSocketPath(socketpath), fListenFD(-1), fMaxMemory(max_memory), fMemory(0), fUseCount(0)
+  {
+    sockaddr_un addr;
+    if ( !make_address( fSocketPath, addr ) )
+      throw std::runtime_error( "IndexDaemon: socket path too long: "+fSocketPath );
+
+    fListenFD = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fListenFD<0 )
+      throw std::runtime_error( "IndexDaemon: could not create socket" );
+
+    unlink( fSocketPath.c_str() ); // stale socket from a previous daemon
+    // the socket file is created accessible to our user only
+    mode_t oldmask = umask( 0177 );
+    int bound = bind( fListenFD, (sockaddr*)&addr, sizeof(addr) );
+    umask( oldmask );
+    if ( bound!=0 || chmod( fSocketPath.c_str(), 0600 )!=0 || listen( fListenFD, 128 )!=0 ) {
+      std::stringstream ss;
+      ss << "IndexDaemon: could not listen on " << fSocketPath << ": " << strerror(errno);
+      close( fListenFD );
+      fListenFD = -1;
+      throw std::runtime_error( ss.str() );
+    }
+    std::cout << "[IndexDaemon] listening on " << fSocketPath << std::endl;
+  }
+
+  IndexDaemon::~IndexDaemon() {
+    if ( fListenFD>=0 ) {
+      close( fListenFD );
+      unlink( fSocketPath.c_str() );
+    }
+  }
+
+  std::string IndexDaemon::default_socket() {
+    const char* env = getenv( "LARLITECV_INDEXD_SOCKET" );
+    if ( env && std::string(env)!="" ) return std::string(env);
+    std::stringstream ss;
+    ss << "/tmp/larlitecv_indexd_" << getuid() << ".sock";
+    return ss.str();
+  }
+
+  void IndexDaemon::serve() {
+    // requests are handled one at a time: concurrent clients asking for the same index
+    // simply queue behind the first one and are then answered from memory. a client that
+    // stops sending or reading holds the queue up for at most kTimeout seconds.
+    bool running = true;
+    while ( running ) {
+      int connection = accept( fListenFD, NULL, NULL );
+      if ( connection<0 ) {
+	if ( errno==EINTR ) continue;
+	std::cout << "[IndexDaemon] accept failed: " << strerror(errno) << std::endl;
+	break;
+      }
+      if ( !peer_is_same_user( connection ) ) {
+	std::cout << "[IndexDaemon] refused a connection from another user" << std::endl;
+	close( connection );
+	continue;
+      }
+      set_timeouts( connection, kTimeout );
+      running = handle( connection );
+      close( connection );
+    }
+    std::cout << "[IndexDaemon] shutting down" << std::endl;
+  }
+
+  bool IndexDaemon::handle( int connection ) {
+    std::string request;
+    if ( !recv_message( connection, request ) ) return true; // client went away
+
+    if ( request=="SHUTDOWN" ) {
+      send_message( connection, "OK" );
+      return false;
+    }
+
+    std::vector<std::string> fields;
+    std::stringstream ss( request );
+    std::string field;
+    while ( std::getline( ss, field ) ) fields.push_back( field );
+    if ( ( fields.size()!=4 && fields.size()!=5 ) || fields[0]!="INDEX" ) {
+      send_message( connection, "ERR malformed request" );
+      return true;
+    }
+
+    std::string segment;
+    std::string errmsg;
+    std::string required = ( fields.size()==5 ) ? fields[4] : "";
+    if ( build_index( fields[1], fields[2], fields[3], required, segment, errmsg ) )
+      send_message( connection, segment );
+    else
+      send_message( connection, "ERR "+errmsg );
+    return true;
+  }
+
+  bool IndexDaemon::build_index( const std::string& ftype, const std::string& cwd, const std::string& filelist,
+				 const std::string& required, std::string& segment, std::string& errmsg ) {
+
+    // the filelist contents, not its name, define the index
+    hashwrapper *myWrapper = new md5wrapper();
+    std::string hash;
+    try {
+      hash = myWrapper->getHashFromFile( filelist.c_str() );
+    }
+    catch (...) {
+      delete myWrapper;
+      errmsg = "could not read filelist "+filelist;
+      return false;
+    }
+    delete myWrapper;
+
+    // relative paths inside the filelist are relative to the client
+    if ( chdir( cwd.c_str() )!=0 ) {
+      errmsg = "could not enter client directory "+cwd;
+      return false;
+    }
+
+    std::string key = ftype+":"+cwd+":"+hash;
+    if ( required!="" ) key += ":"+required;
+    std::vector<std::string> inputs;
+    std::vector<int64_t> stamps;
+    if ( !stamp_inputs( filelist, inputs, stamps ) ) {
+      errmsg = "could not read filelist "+filelist;
+      return false;
+    }
+    auto iter = fSegments.find( key );
+    if ( iter!=fSegments.end() ) {
+      if ( iter->second.inputs==inputs && iter->second.stamps==stamps ) {
+	iter->second.last_used = ++fUseCount;
+	segment = iter->second.index;
+	return true;
+      }
+      std::cout << "[IndexDaemon] files of " << filelist << " changed since their index was built. Rebuilding." << std::endl;
+      fMemory -= iter->second.index.size();
+      fSegments.erase( iter );
+    }
+
+    FileManager* fman = NULL;
+    if ( ftype=="larlite" )    fman = new LarliteFileManager( filelist, false );
+    else if ( ftype=="larcv" ) fman = new LarcvFileManager( filelist, false );
+    else {
+      errmsg = "unknown filetype "+ftype;
+      return false;
+    }
+
+    std::vector<std::string> trees;
+    std::stringstream ss( required );
+    std::string tree;
+    while ( std::getline( ss, tree, ',' ) ) {
+      if ( tree!="" ) trees.push_back( tree );
+    }
+    fman->setRequiredTrees( trees );
+
+    std::cout << "[IndexDaemon] building " << ftype << " index for " << filelist << std::endl;
+    try {
+      fman->initialize();
+    }
+    catch ( std::exception& e ) {
+      delete fman;
+      errmsg = e.what();
+      return false;
+    }
+    fman->serialize_index( segment );
+    delete fman;
+
+    // stamped before the build: a file changing during it makes the next request rebuild
+    Segment kept;
+    kept.index     = segment;
+    kept.inputs    = inputs;
+    kept.stamps    = stamps;
+    kept.last_used = ++fUseCount;
+    fSegments[key] = kept;
+    fMemory += segment.size();
+    evict();
+    std::cout << "[IndexDaemon] serving " << key << " (" << segment.size() << " bytes)" << std::endl;
+    return true;
+  }
+
+  bool IndexDaemon::stamp_inputs( const std::string& filelist, std::vector<std::string>& inputs, std::vector<int64_t>& stamps ) {
+    // same files as FileManager::parse_filelist. a missing file stamps as -1
+    std::ifstream infile( filelist.c_str() );
+    if ( !infile.good() ) return false;
+    std::string line;
+    while ( std::getline( infile, line ) ) {
+      if ( line=="" ) continue;
+      struct stat info;
+      bool found = ( stat( line.c_str(), &info )==0 );
+      inputs.push_back( line );
+      stamps.push_back( found ? (int64_t)info.st_size  : -1 );
+      stamps.push_back( found ? (int64_t)info.st_mtime : -1 );
+    }
+    return true;
+  }
+
+  void IndexDaemon::evict() {
+    // the most recently used segment always stays, even if it alone is over the limit
+    while ( fMemory>fMaxMemory && fSegments.size()>1 ) {
+      auto oldest = fSegments.begin();
+      for ( auto iter=fSegments.begin(); iter!=fSegments.end(); ++iter ) {
+	if ( iter->second.last_used<oldest->second.last_used ) oldest = iter;
+      }
+      std::cout << "[IndexDaemon] dropping " << oldest->first << " (" << oldest->second.index.size() << " bytes)" << std::endl;
+      fMemory -= oldest->second.index.size();
+      fSegments.erase( oldest );
+    }
+  }
+
+  // ---------------------------------------------------------------------
+  // client
+
+  IndexClient::IndexClient( std::string socketpath, int timeout )
+    : fSocketPath(socketpath), fTimeout(timeout), fLastError("")
+  {}
+
+  bool IndexClient::transact( const std::string& request, std::string& response ) {
+    sockaddr_un addr;
+    if ( !make_address( fSocketPath, addr ) ) {
+      fLastError = "socket path too long";
+      return false;
+    }
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd<0 ) {
+      fLastError = strerror(errno);
+      return false;
+    }
+    // the timeouts also bound connect(), should the daemon's queue be full
+    set_timeouts( fd, fTimeout );
+    if ( connect( fd, (sockaddr*)&addr, sizeof(addr) )!=0 ) {
+      fLastError = strerror(errno);
+      close( fd );
+      return false;
+    }
+    if ( !peer_is_same_user( fd ) ) {
+      fLastError = "socket is served by another user";
+      close( fd );
+      return false;
+    }
+    bool ok = send_message( fd, request ) && recv_message( fd, response );
+    int err = errno;
+    close( fd );
+    if ( !ok ) {
+      if ( err==EAGAIN || err==EWOULDBLOCK ) fLastError = "no answer from daemon in time";
+      else fLastError = "connection to daemon lost";
+      return false;
+    }
+    if ( response.compare( 0, 4, "ERR " )==0 ) {
+      fLastError = response.substr( 4 );
+      return false;
+    }
+    return true;
+  }
+
+  bool IndexClient::request_index( const std::string& ftype, const std::string& filelist, const std::vector<std::string>& required,
+				   std::string& segment ) {
+    char pathbuf[PATH_MAX];
+    if ( realpath( filelist.c_str(), pathbuf )==NULL ) {
+      fLastError = "could not resolve "+filelist;
+      return false;
+    }
+    std::string abslist = pathbuf;
+    if ( getcwd( pathbuf, sizeof(pathbuf) )==NULL ) {
+      fLastError = "could not get working directory";
+      return false;
+    }
+    std::string cwd = pathbuf;
+    std::string request = "INDEX\n"+ftype+"\n"+cwd+"\n"+abslist;
+    if ( !required.empty() ) {
+      request += "\n";
+      for ( size_t i=0; i<required.size(); i++ ) request += ( i>0 ? "," : "" )+required[i];
+    }
+    return transact( request, segment );
+  }
+
+  bool IndexClient::request_shutdown() {
+    std::string response;
+    return transact( "SHUTDOWN", response );
+  }
+
+}
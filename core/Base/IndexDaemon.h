@@ -0,0 +1,99 @@
+#ifndef __INDEX_DAEMON__
+#define __INDEX_DAEMON__
+
+#include <string>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace larlitecv {
+
+  // Node-local index service.
+  //
+  // Many jobs on the same host running over the same filelist would each build the same
+  // FileManager index. The IndexDaemon listens on a unix domain socket (no network), builds
+  // each requested index once and keeps the serialized result in memory. Clients (FileManager via
+  // IndexClient) receive a read-only copy of the index. If no daemon is listening, or it does not
+  // answer in time, FileManager builds the index in-process as before.
+  //
+  // A kept index is served again only while every file of its filelist has the size and mtime it
+  // had when the index was built; otherwise it is rebuilt. The least recently used indices are
+  // dropped beyond max_memory bytes.
+  //
+  // The socket is only accessible to the daemon's user (mode 0600), and both sides check that the
+  // peer runs as the same user. Connections time out, so a hung peer blocks nobody for long.
+  //
+  // wire protocol: every message is a uint32 length followed by that many bytes.
+  //   request:  "INDEX\n<filetype>\n<client cwd>\n<absolute filelist path>[\n<required trees, comma separated>]"
+  //             or  "SHUTDOWN"
+  //   response: serialized index (see FileManager::serialize_index) or "ERR <message>"
+
+  class IndexDaemon {
+
+  public:
+
+    IndexDaemon( std::string socketpath, size_t max_memory=kDefaultMaxMemory );
+    virtual ~IndexDaemon();
+
+    void serve(); ///< blocks, answering requests until a SHUTDOWN request arrives
+    static std::string default_socket(); ///< $LARLITECV_INDEXD_SOCKET or /tmp/larlitecv_indexd_<uid>.sock
+
+    static const size_t kDefaultMaxMemory = (size_t)1<<30; ///< bytes of serialized indices kept
+    static const int kTimeout = 10; ///< seconds the daemon waits on a client's request or for it to take the reply
+
+  protected:
+
+    // one kept index
+    struct Segment {
+      std::string index;                ///< serialized index
+      std::vector<std::string> inputs;  ///< every file of the filelist
+      std::vector<int64_t> stamps;      ///< size and mtime of each input when the index was built
+      uint64_t last_used;
+    };
+
+    bool handle( int connection ); ///< returns false when asked to shut down
+    bool build_index( const std::string& ftype, const std::string& cwd, const std::string& filelist,
+		      const std::string& required, std::string& segment, std::string& errmsg );
+    static bool stamp_inputs( const std::string& filelist, std::vector<std::string>& inputs, std::vector<int64_t>& stamps );
+    void evict(); ///< drop the least recently used segments until we are within fMaxMemory
+
+    std::string fSocketPath;
+    int fListenFD;
+    size_t fMaxMemory;
+    size_t fMemory;     ///< bytes held by fSegments
+    uint64_t fUseCount;
+    std::map< std::string, Segment > fSegments; ///< key: filetype:cwd:filelist hash[:required]
+  };
+
+  class IndexClient {
+
+  public:
+
+    IndexClient( std::string socketpath, int timeout=kTimeout );
+    virtual ~IndexClient() {};
+
+    bool request_index( const std::string& ftype, const std::string& filelist, const std::vector<std::string>& required,
+			std::string& segment );
+    bool request_shutdown();
+    const std::string& last_error() const { return fLastError; };
+
+    static const int kTimeout = 120; ///< seconds to wait for the daemon, including building the index, before building it ourselves
+
+  protected:
+
+    bool transact( const std::string& request, std::string& response );
+
+    std::string fSocketPath;
+    int fTimeout;
+    std::string fLastError;
+  };
+
+  // message framing shared by daemon and client
+  bool send_message( int fd, const std::string& msg );
+  bool recv_message( int fd, std::string& msg );
+  bool set_timeouts( int fd, int seconds ); ///< send and receive timeouts
+  bool peer_is_same_user( int fd );        ///< the process at the other end runs as our user
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "IndexSummary.h"
+#include <iostream>
+#include "TFile.h"
+#include "TTree.h"
+
+namespace larlitecv {
+
+  bool IndexSummary::write( const std::string& filepath, const RSElist& saved ) {
+    TFile rfile( filepath.c_str(), "UPDATE" );
+    if ( rfile.IsZombie() ) return false;
+    TTree tsummary( tree_name(), "larlitecv index summary v1" );
+    int run, subrun, first_event, subevent;
+    Long64_t nentries;
+    tsummary.Branch( "run",         &run,         "run/I" );
+    tsummary.Branch( "subrun",      &subrun,      "subrun/I" );
+    tsummary.Branch( "first_event", &first_event, "first_event/I" );
+    tsummary.Branch( "subevent",    &subevent,    "subevent/I" );
+    tsummary.Branch( "nentries",    &nentries,    "nentries/L" );
+    for ( auto const& range : saved.ranges() ) {
+      run         = range.run;
+      subrun      = range.subrun;
+      first_event = range.first_event;
+      subevent    = range.subevent;
+      nentries    = range.nentries;
+      tsummary.Fill();
+    }
+    tsummary.Write();
+    rfile.Close();
+    return true;
+  }
+
+  bool IndexSummary::read( TFile& rfile, Entry_t nentries, std::vector<RSE>& entries ) {
+    TTree* tsummary = (TTree*)rfile.Get( tree_name() );
+    if ( tsummary==nullptr ) return false;
+    int run, subrun, first_event, subevent;
+    Long64_t range_entries;
+    tsummary->SetBranchAddress( "run",         &run );
+    tsummary->SetBranchAddress( "subrun",      &subrun );
+    tsummary->SetBranchAddress( "first_event", &first_event );
+    tsummary->SetBranchAddress( "subevent",    &subevent );
+    tsummary->SetBranchAddress( "nentries",    &range_entries );
+
+    // check the total first: a file written some other way (or by an older version) is scanned instead
+    std::vector<RSERange> ranges;
+    Entry_t total = 0;
+    for ( Long64_t irow=0; irow<tsummary->GetEntries(); irow++ ) {
+      tsummary->GetEntry( irow );
+      RSERange range( RSE( run, subrun, first_event, subevent ), total );
+      range.nentries = range_entries;
+      ranges.push_back( range );
+      total += range_entries;
+    }
+    if ( total!=nentries ) return false;
+
+    entries.clear();
+    entries.reserve( total );
+    for ( auto const& range : ranges ) {
+      for ( Entry_t i=0; i<range.nentries; i++ ) entries.push_back( range.at( range.first_entry+i ) );
+    }
+    return true;
+  }
+
+}
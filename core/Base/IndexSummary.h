@@ -0,0 +1,38 @@
+#ifndef __INDEX_SUMMARY__
+#define __INDEX_SUMMARY__
+
+#include <string>
+#include <vector>
+#include "FileManagerTypes.h"
+
+class TFile;
+
+namespace larlitecv {
+
+  // Event index stored inside an output file.
+  //
+  // At finalize, DataCoordinator appends a small tree to each file it wrote: the RSEs of the saved
+  // entries, as RSERanges (run, subrun, first_event, subevent, nentries), so a few rows per file.
+  // LarliteFileManager and LarcvFileManager read it instead of scanning the file's whole id tree.
+  // Outputs merged with OutputMerger keep a valid summary: the trees are concatenated in the same
+  // order as the id trees.
+  class IndexSummary {
+
+  public:
+
+    IndexSummary() {};
+    virtual ~IndexSummary() {};
+
+    static const char* tree_name() { return "larlitecv_index"; }; ///< does not end in _tree, so it is not taken for a data product
+
+    /// append the summary of saved to the ROOT file at filepath
+    static bool write( const std::string& filepath, const RSElist& saved );
+
+    /// RSE of every entry, from rfile's summary. false if there is none, or it does not hold nentries entries.
+    static bool read( TFile& rfile, Entry_t nentries, std::vector<RSE>& entries );
+
+  };
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "LarcvFileManager.h"
+#include "IndexSummary.h"
 #include "Hashlib2plus/hashlibpp.h"
 #include "TFile.h"
 #include "TTree.h"
@@ -25,7 +26,9 @@ namespace larlitecv {
 
   void LarcvFileManager::user_build_index( const std::vector<std::string>& input, 
 					   std::vector<std::string>& finallist,
-					   std::map< RSE, int >& rse2entry, std::map< int, RSE >& entry2rse ) {
+					   RSElist& entry2rse,
+					   std::vector<FileBlock>& fileblocks,
+					   std::vector<FileInfo>& fileinfo ) {
     std::set<std::string> producers;
     std::set<std::string> datatypes;
     std::set<std::string> treeflavors;
@@ -33,6 +36,12 @@ namespace larlitecv {
     std::map< std::string, RSElist > file_rselist;
     std::map< RSElist, std::set<std::string> > rse_flavors;
     std::map< RSElist, std::vector<std::string> > rse_filelist; 
+    std::map< std::string, FileInfo > file_info; // what we learned about each file while it was open
+    int npruned = 0; // files without any of the required trees
+    std::vector<RSE> idtree_rse;                               // reused for every file
+    std::vector< std::pair<RSEKey,Entry_t> > duplicate_scratch; // reused for every file
+    Entry_t nrepeats = 0;
+    int nsummaries = 0; // files indexed from their embedded summary
 
     // in order to build an event index, we need to get for each file
     //   (1) the run, subrun, event number for each file's entry
@@ -81,6 +90,11 @@ namespace larlitecv {
         continue; // skip this file, we won't know how to index it.
       }
 
+      if ( !has_required_tree( trees ) ) {
+        npruned++;
+        continue; // none of the products asked for. never needs to be opened again.
+      }
+
       // make a hash out of the name of tree is the file. will be used to define the flavor of this file
       std::string treehashname = ":";
       for ( std::set<std::string>::iterator it=trees.begin(); it!=trees.end(); it++ ) {
@@ -125,29 +139,38 @@ namespace larlitecv {
         throw std::runtime_error(msg);
       }
 
-      std::set<RSE> file_entries;
-      std::map<RSE,int> duplicate_counter;
-      while ( bytes>0 ) {
-        run = product_ptr->run();
-        subrun = product_ptr->subrun();
-        event = product_ptr->event();
-        RSE entry( (int)run, (int)subrun, (int)event );
-	if ( file_entries.find(entry)!=file_entries.end() ) {
-	  // duplicate RSE!
-	  RSE duplicate((int)run,(int)subrun,(int)event);
-	  if ( duplicate_counter.find(duplicate)==duplicate_counter.end() )
-	    duplicate_counter.insert( std::pair<RSE,int>(duplicate,0) );
-	  // add subevent number
-	  entry.subevent = ++duplicate_counter[duplicate];
-	}
-	file_entries.insert(entry);
-        fileentry_rse.emplace_back( std::move(entry) );
-        idtree_entry++;
+      Long64_t nid = idtree->GetEntries();
+      // files we wrote carry a summary. trust it if it also agrees on the first and last event
+      bool from_summary = IndexSummary::read( rfile, nid, idtree_rse ) && nid>0
+        && idtree_rse.front()==RSE( (int)product_ptr->run(), (int)product_ptr->subrun(), (int)product_ptr->event() )
+        && idtree->GetEntry( nid-1 )>0
+        && idtree_rse.back()==RSE( (int)product_ptr->run(), (int)product_ptr->subrun(), (int)product_ptr->event() );
+      if ( from_summary ) nsummaries++;
+      else {
+        idtree_rse.clear();
+        idtree_rse.reserve( nid );
         bytes = idtree->GetEntry( idtree_entry );
+        while ( bytes>0 ) {
+          run = product_ptr->run();
+          subrun = product_ptr->subrun();
+          event = product_ptr->event();
+          idtree_rse.push_back( RSE( (int)run, (int)subrun, (int)event ) );
+          idtree_entry++;
+          bytes = idtree->GetEntry( idtree_entry );
+        }
       }
+      // repeated RSEs in this file get subevent numbers
+      nrepeats += assign_subevents( idtree_rse, duplicate_scratch );
+      for ( auto const& entry : idtree_rse ) fileentry_rse.push_back( entry );
       //std::cout << "last idtree entry: " << idtree_entry << " " << fileentry_rse.size() << std::endl;
       file_rselist.insert( std::pair< std::string, RSElist >( fpath, fileentry_rse ) );
 
+      FileInfo info;
+      info.nentries = fileentry_rse.size();
+      info.trees.assign( trees.begin(), trees.end() );
+      stat_file( fpath, info.size, info.mtime );
+      file_info[fpath] = info;
+
       // we associate an event list to a list of file flavors
       bool found_similar_eventlist = false;
       for ( auto &iter : rse_flavors ) {
@@ -182,22 +205,29 @@ namespace larlitecv {
 	
     }//end of file list loop
 
+    if ( nsummaries>0 )
+      std::cout << "[LarcvFileManager] " << nsummaries << " of " << input.size() << " files indexed from their embedded summary." << std::endl;
+    if ( nrepeats>0 )
+      std::cout << "[LarcvFileManager] " << nrepeats << " repeated events within files were given subevent numbers." << std::endl;
+    if ( npruned>0 )
+      std::cout << "[LarcvFileManager] " << npruned << " of " << input.size() << " files hold none of the required trees. Not used." << std::endl;
+
     // ok, we now have maps where
     // flavor to list of files
     // RSE list to a list of files
     
     // we now count how many events each flavor-set has
-    std::map< std::set<std::string>, int > numevents_per_flavorset;
+    std::map< std::set<std::string>, Entry_t > numevents_per_flavorset;
     for ( auto& iter : rse_flavors ) {
       // have we already seen this flavor set? (if this doesn't work, can hash the flavor sets first
       if ( numevents_per_flavorset.find( iter.second )==numevents_per_flavorset.end() ) {
-        numevents_per_flavorset.insert( std::pair< std::set<std::string>, int >(iter.second, 0 ) );
+        numevents_per_flavorset.insert( std::pair< std::set<std::string>, Entry_t >(iter.second, 0 ) );
       }
-      numevents_per_flavorset.find( iter.second  )->second += (int)iter.first.size();
+      numevents_per_flavorset.find( iter.second  )->second += iter.first.size();
     }
 
     // we choose the flavor set with the most events
-    int num_in_maxset = -1;
+    Entry_t num_in_maxset = -1;
     std::set<std::string> maxset;
     for ( auto& iter: numevents_per_flavorset ) {
       if ( iter.second>num_in_maxset ) {
@@ -208,15 +238,20 @@ namespace larlitecv {
 
     // now we finally fill what we've been asked to fill
     finallist.clear();
-    rse2entry.clear();
     entry2rse.clear();
+    fileblocks.clear();
+    fileinfo.clear();
 
-    // make filelist
+    // make filelist. files of different flavors share an rselist: keep each rselist once,
+    // its files are all added below as one block.
     std::vector<RSElist> finalrseset;
+    std::set<RSElist> seen_rselists;
     for ( auto &flavorset : maxset ) {
       std::vector<std::string>& files = flavorfiles.find( flavorset )->second;
       for ( auto &file : files ) {
         RSElist& rselist = file_rselist.find( file )->second;
+        if ( seen_rselists.find( rselist )!=seen_rselists.end() ) continue;
+        seen_rselists.insert( rselist );
         finalrseset.push_back( rselist ); // this use to be a set....
       }
     }
@@ -228,25 +263,19 @@ namespace larlitecv {
       sort( finalrse_v.begin(), finalrse_v.end() );
 
     // make rse dictionaries
-    int entrynum = 0;
     for ( auto &rselist : finalrse_v ) {
-      for ( auto &rse: rselist ) {
-        rse2entry.insert( std::pair< RSE, int >( rse, entrynum ) );
-        entry2rse.insert( std::pair< int, RSE >( entrynum, rse ) );
-	//std::cout << entrynum << " " << rse << std::endl;	
-        entrynum++;
-      }
-      
+      int first_file = (int)finallist.size();
       auto iter_rse2flist = rse_filelist.find( rselist );
       for ( auto &fpath : iter_rse2flist->second ) {
         finallist.push_back( fpath ); // we end up resorting
+        fileinfo.push_back( file_info[fpath] );
       }
-      
+      append_block( rselist, first_file, (int)finallist.size()-first_file, entry2rse, fileblocks );
     }
     
     // std::cout << "Max flavor set has " << numevents_per_flavorset.find(maxset)->second << " entries. "
     //   << "Consists of " << maxset.size() << " different tree flavors." << std::endl;
-    //std::cout << "Index sizes: " << rse2entry.size() << " vs. entries: "<< entrynum << std::endl;
+    //std::cout << "Index sizes: " << entry2rse.size() << " entries in " << entry2rse.ranges().size() << " ranges" << std::endl;
     //std::cout << "Final file list size: " << ffinallist.size() << std::endl;
       
   }//end of user_build_index
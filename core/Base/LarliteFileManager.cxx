@@ -1,4 +1,5 @@
 #include "LarliteFileManager.h"
+#include "IndexSummary.h"
 #include "Hashlib2plus/hashlibpp.h"
 #include "TFile.h"
 #include "TTree.h"
@@ -22,7 +23,9 @@ namespace larlitecv {
 
   void LarliteFileManager::user_build_index( const std::vector<std::string>& input,
 					     std::vector<std::string>& finallist,
-					     std::map< RSE, int >& rse2entry, std::map< int, RSE >& entry2rse ) {
+					     RSElist& entry2rse,
+					     std::vector<FileBlock>& fileblocks,
+					     std::vector<FileInfo>& fileinfo ) {
     
     std::set<std::string> producers; // list of all producers found
     std::set<std::string> datatypes; // list of all data types found
@@ -31,6 +34,12 @@ namespace larlitecv {
     std::map< std::string, RSElist > file_rselist; // map of file with the list of (run,subrun,events)
     std::map< RSElist, std::set<std::string> > rse_flavors; // map of rselist to set of flavors
     std::map< RSElist, std::vector<std::string> > rse_filelist; // map of rselist to list of files
+    std::map< std::string, FileInfo > file_info; // what we learned about each file while it was open
+    int npruned = 0; // files without any of the required trees
+    std::vector<RSE> idtree_rse;                               // reused for every file
+    std::vector< std::pair<RSEKey,Entry_t> > duplicate_scratch; // reused for every file
+    Entry_t nrepeats = 0;
+    int nsummaries = 0; // files indexed from their embedded summary
 
     // in order to build an event index, we need to get for each file
     //   (1) the run, subrun, event number for each file's entry
@@ -51,6 +60,7 @@ namespace larlitecv {
       for (int ikey=0; ikey<nkeys; ikey++) {
 	
 	std::string keyname = rfile.GetListOfKeys()->At(ikey)->GetName();
+	if ( keyname==IndexSummary::tree_name() ) continue; // not a product, and must not change the flavor
 	if ( keyname=="larlite_id_tree" ) found_id_tree = true;
 	size_t found1 = keyname.find("_");
 	size_t found2 = keyname.find_last_of("_");
@@ -65,6 +75,11 @@ namespace larlitecv {
       if ( !found_id_tree )
 	continue; // skip this file, we won't know how to index it.
 
+      if ( !has_required_tree( trees ) ) {
+	npruned++;
+	continue; // none of the products asked for. never needs to be opened again.
+      }
+
       // make a hash out of the name of tree is the file. will be used to define the flavor of this file
       std::string treehashname = ":";
       for ( std::set<std::string>::iterator it=trees.begin(); it!=trees.end(); it++ ) {
@@ -88,24 +103,31 @@ namespace larlitecv {
 
       long bytes = idtree->GetEntry(0);
       long idtree_entry = 0;
-      std::set<RSE> file_entries;
-      std::map<RSE,int> duplicate_counter;      
-      while ( bytes>0 ) {
-	RSE entry( run, subrun, event, 0 );
-	if ( file_entries.find(entry)!=file_entries.end() ) {
-	  // duplicate RSE!
-	  RSE duplicate((int)run,(int)subrun,(int)event, 0);
-	  if ( duplicate_counter.find(duplicate)==duplicate_counter.end() )
-	    duplicate_counter.insert( std::pair<RSE,int>(duplicate,0) );
-	  // add subevent number
-	  entry.subevent = ++duplicate_counter[duplicate];
+      Long64_t nid = idtree->GetEntries();
+      // files we wrote carry a summary. trust it if it also agrees on the first and last event
+      bool from_summary = IndexSummary::read( rfile, nid, idtree_rse ) && nid>0
+	&& idtree_rse.front()==RSE( run, subrun, event ) && idtree->GetEntry( nid-1 )>0 && idtree_rse.back()==RSE( run, subrun, event );
+      if ( from_summary ) nsummaries++;
+      else {
+	idtree_rse.clear();
+	idtree_rse.reserve( nid );
+	bytes = idtree->GetEntry(0);
+	while ( bytes>0 ) {
+	  idtree_rse.push_back( RSE( run, subrun, event, 0 ) );
+	  bytes = idtree->GetEntry( ++idtree_entry );
 	}
-	file_entries.insert( entry );		
-	fileentry_rse.emplace_back( entry );
-	bytes = idtree->GetEntry( ++idtree_entry );
       }
+      // repeated RSEs in this file get subevent numbers
+      nrepeats += assign_subevents( idtree_rse, duplicate_scratch );
+      for ( auto const& entry : idtree_rse ) fileentry_rse.push_back( entry );
       file_rselist.insert( std::pair< std::string, RSElist >( fpath, fileentry_rse ) );
 
+      FileInfo info;
+      info.nentries = fileentry_rse.size();
+      info.trees.assign( trees.begin(), trees.end() );
+      stat_file( fpath, info.size, info.mtime );
+      file_info[fpath] = info;
+
       // we associate an event list to a list of file flavors
       bool found_similar_eventlist = false;
       for ( auto &iter : rse_flavors ) {
@@ -140,22 +162,29 @@ namespace larlitecv {
 	
     }//end of file list loop
 
+    if ( nsummaries>0 )
+      std::cout << "[LarliteFileManager] " << nsummaries << " of " << input.size() << " files indexed from their embedded summary." << std::endl;
+    if ( nrepeats>0 )
+      std::cout << "[LarliteFileManager] " << nrepeats << " repeated events within files were given subevent numbers." << std::endl;
+    if ( npruned>0 )
+      std::cout << "[LarliteFileManager] " << npruned << " of " << input.size() << " files hold none of the required trees. Not used." << std::endl;
+
     // ok, we now have maps where
     // flavor to list of files
     // RSE list to a list of files
     
     // we now count how many events each flavor-set has
-    std::map< std::set<std::string>, int > numevents_per_flavorset;
+    std::map< std::set<std::string>, Entry_t > numevents_per_flavorset;
     for ( auto& iter : rse_flavors ) {
       // have we already seen this flavor set? (if this doesn't work, can hash the flavor sets first
       if ( numevents_per_flavorset.find( iter.second )==numevents_per_flavorset.end() ) {
-	numevents_per_flavorset.insert( std::pair< std::set<std::string>, int >(iter.second, 0 ) );
+	numevents_per_flavorset.insert( std::pair< std::set<std::string>, Entry_t >(iter.second, 0 ) );
       }
-      numevents_per_flavorset.find( iter.second  )->second += (int)iter.first.size();
+      numevents_per_flavorset.find( iter.second  )->second += iter.first.size();
     }
 
     // we choose the flavor set with the most events
-    int num_in_maxset = -1;
+    Entry_t num_in_maxset = -1;
     std::set<std::string> maxset;
     for ( auto& iter: numevents_per_flavorset ) {
       if ( iter.second>num_in_maxset ) {
@@ -166,15 +195,20 @@ namespace larlitecv {
 
     // now we finally fill what we've been asked to fill
     finallist.clear();
-    rse2entry.clear();
     entry2rse.clear();
+    fileblocks.clear();
+    fileinfo.clear();
 
-    // make filelist
+    // make filelist. files of different flavors share an rselist: keep each rselist once,
+    // its files are all added below as one block.
     std::vector<RSElist> finalrseset;
+    std::set<RSElist> seen_rselists;
     for ( auto &flavorset : maxset ) {
       std::vector<std::string>& files = flavorfiles.find( flavorset )->second;
       for ( auto &file : files ) {
 	RSElist& rselist = file_rselist.find( file )->second;
+	if ( seen_rselists.find( rselist )!=seen_rselists.end() ) continue;
+	seen_rselists.insert( rselist );
 	finalrseset.push_back( rselist );
       }
     }
@@ -186,26 +220,21 @@ namespace larlitecv {
       sort( finalrse_v.begin(), finalrse_v.end() );
 
     // make rse dictionaries
-    int entrynum = 0;
     for ( auto &rselist : finalrse_v ) {
-      
-      for ( auto &rse: rselist ) {
-	rse2entry.insert( std::pair< RSE, int >( rse, entrynum ) );
-	entry2rse.insert( std::pair< int, RSE >( entrynum, rse ) );
-	//std::cout << entrynum << " " << rse << std::endl;
-	entrynum++;
-      }
-      
+
+      int first_file = (int)finallist.size();
       auto iter_rse2flist = rse_filelist.find( rselist );
       for ( auto &fpath : iter_rse2flist->second ) {
 	finallist.push_back( fpath ); // we end up resorting
-	//std::cout << "final list: " << fpath << " (ientry=" << entrynum << ",rse=" << rselist.run() << "," << rselist.subrun() << ")" << std::endl;
+	fileinfo.push_back( file_info[fpath] );
+	//std::cout << "final list: " << fpath << " (ientry=" << entry2rse.size() << ",rse=" << rselist.run() << "," << rselist.subrun() << ")" << std::endl;
       }
+      append_block( rselist, first_file, (int)finallist.size()-first_file, entry2rse, fileblocks );
     }
     
 //     std::cout << "Max flavor set has " << numevents_per_flavorset.find(maxset)->second << " entries. "
 // 	      << "Consists of " << maxset.size() << " different tree flavors." << std::endl;
-    std::cout << "Index sizes: " << rse2entry.size() << " vs. entries: "<< entrynum << std::endl;
+    std::cout << "Index sizes: " << entry2rse.size() << " entries in " << entry2rse.ranges().size() << " ranges" << std::endl;
     std::cout << "Final file list size: " << ffinallist.size() << std::endl;
 
     
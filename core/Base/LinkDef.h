@@ -15,6 +15,15 @@
 #pragma link C++ class larlitecv::LarliteFileManager+;
 #pragma link C++ class larlitecv::LarcvFileManager+;
 #pragma link C++ class larlitecv::DataCoordinator+;
+#pragma link C++ class larlitecv::IndexDaemon+;
+#pragma link C++ class larlitecv::IndexClient+;
+#pragma link C++ class larlitecv::ShardPlanner+;
+#pragma link C++ class larlitecv::OutputMerger+;
+#pragma link C++ class larlitecv::EventCostTable+;
+#pragma link C++ class larlitecv::IndexSummary+;
+#pragma link C++ class larlitecv::MetadataCut+;
+#pragma link C++ class larlitecv::EventMetadata+;
+#pragma link C++ class larlitecv::AsyncNavigator+;
 //ADD_NEW_CLASS ... do not change this line
 
 #endif
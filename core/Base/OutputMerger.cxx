@@ -0,0 +1,78 @@
+#include "OutputMerger.h"
+#include "DataCoordinator.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include "TFileMerger.h"
+
+namespace larlitecv {
+
+  std::string OutputMerger::worker_filename( const std::string& target, const std::string& tag, int iworker ) {
+    std::stringstream ss;
+    size_t dot = target.find_last_of(".");
+    size_t slash = target.find_last_of("/");
+    if ( dot==std::string::npos || ( slash!=std::string::npos && dot<slash ) )
+      ss << target << "_" << tag << iworker;
+    else
+      ss << target.substr(0,dot) << "_" << tag << iworker << target.substr(dot);
+    return ss.str();
+  }
+
+  bool OutputMerger::merge( const std::vector<std::string>& inputs, const std::string& target, bool remove_inputs ) {
+    if ( inputs.empty() ) return true;
+
+    TFileMerger merger( false, false );
+    merger.SetFastMethod( true );
+    if ( !merger.OutputFile( target.c_str(), true ) ) {
+      std::cout << "[OutputMerger] could not open " << target << " for writing." << std::endl;
+      return false;
+    }
+    for ( auto const& input : inputs ) {
+      if ( !merger.AddFile( input.c_str(), false ) ) {
+	std::cout << "[OutputMerger] could not add " << input << std::endl;
+	return false;
+      }
+    }
+    if ( !merger.Merge() ) {
+      std::cout << "[OutputMerger] merging into " << target << " failed." << std::endl;
+      return false;
+    }
+
+    if ( remove_inputs ) {
+      for ( auto const& input : inputs ) std::remove( input.c_str() );
+    }
+    return true;
+  }
+
+  bool OutputMerger::reorder( const std::string& outfile, const std::string& ftype, const std::vector<Entry_t>& order ) {
+    // move the file aside and copy it back, entry by entry, through a DataCoordinator
+    std::string unordered = outfile+".unordered";
+    std::string flist = unordered+".txt";
+    if ( std::rename( outfile.c_str(), unordered.c_str() )!=0 ) {
+      std::cout << "[OutputMerger] could not move " << outfile << " aside." << std::endl;
+      return false;
+    }
+    std::ofstream listout( flist.c_str() );
+    listout << unordered << '\n';
+    listout.close();
+
+    larcv::PSet larcv_copy( "IOManager", ( ftype=="larcv" ) ? "Verbosity: 2 IOMode: 2" : "Verbosity: 2 IOMode: -1" );
+    larcv::PSet larlite_copy( "StorageManager", ( ftype=="larlite" ) ? "IOMode: 2" : "IOMode: -1" );
+    DataCoordinator copy;
+    copy.use_index_cache( false );
+    copy.configure( larcv_copy, larlite_copy );
+    copy.set_filelist( flist, ftype );
+    copy.set_outputfile( outfile, ftype );
+    copy.initialize();
+    for ( auto const& entry : order ) {
+      copy.goto_entry( entry, ftype );
+      copy.save_entry();
+    }
+    copy.finalize();
+    std::remove( unordered.c_str() );
+    std::remove( flist.c_str() );
+    return true;
+  }
+
+}
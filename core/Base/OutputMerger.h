@@ -0,0 +1,32 @@
+#ifndef __OUTPUT_MERGER__
+#define __OUTPUT_MERGER__
+
+#include <string>
+#include <vector>
+#include "FileManagerTypes.h"
+
+namespace larlitecv {
+
+  // Helpers for jobs that write one output file per worker (thread or process)
+  // and combine them into the output file the user asked for.
+  class OutputMerger {
+
+  public:
+
+    OutputMerger() {};
+    virtual ~OutputMerger() {};
+
+    /// name of the file worker iworker writes instead of target, e.g. out.root -> out_t3.root
+    static std::string worker_filename( const std::string& target, const std::string& tag, int iworker );
+
+    /// concatenate the trees of inputs into target (like hadd). inputs are deleted if remove_inputs is set.
+    static bool merge( const std::vector<std::string>& inputs, const std::string& target, bool remove_inputs=true );
+
+    /// rewrite the ftype ("larlite" or "larcv") output file so that its entry i is the old entry order[i]
+    static bool reorder( const std::string& outfile, const std::string& ftype, const std::vector<Entry_t>& order );
+
+  };
+
+}
+
+#endif
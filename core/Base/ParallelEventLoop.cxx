@@ -0,0 +1,181 @@
+#include "ParallelEventLoop.h"
+#include "FileManager.h"
+#include "OutputMerger.h"
+#include "ShardPlanner.h"
+#include "EventCostTable.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include "TROOT.h"
+#endif
+
+namespace larlitecv {
+
+  ParallelEventLoop::ParallelEventLoop( DataCoordinator& source, int nthreads )
+    : fSource(source), fNThreads(nthreads), fChunkSize(100)
+  {
+    if ( fNThreads<1 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " need at least one thread, got " << nthreads << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+  }
+
+  bool ParallelEventLoop::next_chunk( int ithread, EntryRange& chunk ) {
+    {
+      WorkQueue& own = *fQueues[ithread];
+      std::lock_guard<std::mutex> guard( own.lock );
+      if ( !own.chunks.empty() ) {
+	chunk = own.chunks.front();
+	own.chunks.pop_front();
+	return true;
+      }
+    }
+
+    // steal from the back of the fullest queue, i.e. the entries its owner would reach last
+    while ( true ) {
+      int victim = -1;
+      size_t most = 0;
+      for ( int iqueue=0; iqueue<fNThreads; iqueue++ ) {
+	if ( iqueue==ithread ) continue;
+	std::lock_guard<std::mutex> guard( fQueues[iqueue]->lock );
+	if ( fQueues[iqueue]->chunks.size()>most ) {
+	  most = fQueues[iqueue]->chunks.size();
+	  victim = iqueue;
+	}
+      }
+      if ( victim<0 ) return false;
+
+      WorkQueue& other = *fQueues[victim];
+      std::lock_guard<std::mutex> guard( other.lock );
+      if ( other.chunks.empty() ) continue; // its owner got there first. look again.
+      chunk = other.chunks.back();
+      other.chunks.pop_back();
+      return true;
+    }
+  }
+
+  void ParallelEventLoop::worker_loop( DataCoordinator* worker, EventFunc_t func, std::string ftype_driver, int ithread ) {
+    try {
+      EntryRange chunk;
+      while ( next_chunk( ithread, chunk ) ) {
+	{
+	  std::lock_guard<std::mutex> guard( fErrorMutex );
+	  if ( fError!="" ) return;
+	}
+	for ( Entry_t entry=chunk.start; entry<chunk.end; entry++ ) {
+	  worker->goto_entry( entry, ftype_driver );
+	  func( *worker, entry, ithread );
+	}
+      }
+    }
+    catch ( std::exception& e ) {
+      std::lock_guard<std::mutex> guard( fErrorMutex );
+      if ( fError=="" ) fError = e.what();
+    }
+  }
+
+  void ParallelEventLoop::run( EventFunc_t func, std::string ftype_driver, Entry_t start, Entry_t end ) {
+
+    fSource.initialize_index();
+    if ( fSource.get_filemanager( ftype_driver )==nullptr ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " no index for driver '" << ftype_driver << "'" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    Entry_t nentries = fSource.get_nentries( ftype_driver );
+    if ( end<0 || end>nentries ) end = nentries;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+    ROOT::EnableThreadSafety();
+#endif
+
+    // chunks follow the driver's file blocks, so a chunk never makes a reader jump between files.
+    // each thread starts with a contiguous run of chunks.
+    std::vector<EntryRange> chunks = ShardPlanner::make_chunks( *fSource.get_filemanager( ftype_driver ), fSource.get_event_costs(), start, end, fChunkSize );
+    fQueues.clear();
+    for ( int ithread=0; ithread<fNThreads; ithread++ ) fQueues.push_back( std::unique_ptr<WorkQueue>( new WorkQueue ) );
+    for ( size_t ichunk=0; ichunk<chunks.size(); ichunk++ ) {
+      int owner = (int)( ichunk*fNThreads/chunks.size() );
+      fQueues[owner]->chunks.push_back( chunks[ichunk] );
+    }
+
+    // one reader pair per thread, sharing the source's index. these are set up here, one after
+    // another, because ROOT and the IO managers are not safe to configure concurrently.
+    std::string outfiles[2] = { fSource.get_outputfile("larlite"), fSource.get_outputfile("larcv") };
+    std::string ftypes[2]   = { "larlite", "larcv" };
+    std::vector< std::vector<std::string> > thread_outputs(2);
+    std::vector<std::string> thread_costs;
+    std::vector< std::unique_ptr<DataCoordinator> > workers;
+    try {
+      for ( int ithread=0; ithread<fNThreads; ithread++ ) {
+	std::unique_ptr<DataCoordinator> worker( new DataCoordinator );
+	worker->share_index( fSource );
+	for ( int itype=0; itype<2; itype++ ) {
+	  if ( outfiles[itype]=="" ) continue;
+	  std::string threadfile = OutputMerger::worker_filename( outfiles[itype], "t", ithread );
+	  worker->set_outputfile( threadfile, ftypes[itype] );
+	  thread_outputs[itype].push_back( threadfile );
+	}
+	if ( fSource.get_cost_sidecar()!="" ) {
+	  std::string threadcosts = OutputMerger::worker_filename( fSource.get_cost_sidecar(), "t", ithread );
+	  worker->record_event_costs( threadcosts );
+	  thread_costs.push_back( threadcosts );
+	}
+	try {
+	  worker->initialize();
+	}
+	catch ( ... ) {
+	  worker->close(); // whatever it opened before failing
+	  throw;
+	}
+	workers.push_back( std::move( worker ) );
+      }
+    }
+    catch ( ... ) {
+      // close the workers set up so far. the coordinators and queues are freed on the way out.
+      for ( auto& worker : workers ) worker->finalize();
+      fQueues.clear();
+      throw;
+    }
+
+    fError = "";
+    std::vector< std::thread > threads;
+    try {
+      for ( int ithread=0; ithread<fNThreads; ithread++ )
+	threads.push_back( std::thread( &ParallelEventLoop::worker_loop, this, workers[ithread].get(), func, ftype_driver, ithread ) );
+    }
+    catch ( std::exception& e ) {
+      // the threads already started stop at their next chunk
+      std::lock_guard<std::mutex> guard( fErrorMutex );
+      if ( fError=="" ) fError = e.what();
+    }
+    for ( auto& t : threads ) t.join();
+
+    for ( auto& worker : workers ) worker->finalize();
+    workers.clear();
+    fQueues.clear();
+
+    if ( fError!="" ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " event loop stopped: " << fError << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+
+    // combine per-thread outputs
+    for ( int itype=0; itype<2; itype++ ) {
+      if ( !OutputMerger::merge( thread_outputs[itype], outfiles[itype] ) ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " could not merge " << ftypes[itype] << " outputs into " << outfiles[itype] << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+    }
+
+    if ( !thread_costs.empty() && !EventCostTable::merge_files( thread_costs, fSource.get_cost_sidecar() ) )
+      std::cout << "[ParallelEventLoop] could not write event costs to " << fSource.get_cost_sidecar() << std::endl;
+  }
+
+}
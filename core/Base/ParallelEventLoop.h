@@ -0,0 +1,91 @@
+#ifndef __PARALLEL_EVENT_LOOP__
+#define __PARALLEL_EVENT_LOOP__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "FileManagerTypes.h"
+#include "DataCoordinator.h"
+
+namespace larlitecv {
+
+  // Runs a user function over the entries of a DataCoordinator using several threads.
+  //
+  // The index of the source DataCoordinator is built once and shared read-only by all threads.
+  // Each thread gets its own DataCoordinator (its own larlite storage_manager and larcv IOManager).
+  // Entries are handed out in chunks that never cross a file block, so each reader mostly moves
+  // forward through one file at a time. Idle threads steal chunks from the back of busy threads' queues.
+  //
+  // Outputs: each thread writes its own output files (out.root -> out_t<i>.root). They are merged
+  // into the configured output files when run() finishes. Entries in the merged files are grouped
+  // by thread, not in input order.
+  //
+  // If the source uses recorded event costs (DataCoordinator::use_event_costs), chunks hold about
+  // chunk_size entries' worth of time instead of chunk_size entries. If it records costs, the
+  // per-thread sidecars are merged into its sidecar.
+  //
+  // Usage:
+  //   dataco.configure(...); dataco.set_filelist(...);
+  //   dataco.initialize_index();          // not initialize(): the source does not open files itself
+  //   ParallelEventLoop loop( dataco, 8 );
+  //   loop.run( [&]( DataCoordinator& worker, Entry_t entry, int ithread ) { ... worker.save_entry(); } );
+
+  class ParallelEventLoop {
+
+  public:
+
+    typedef std::function< void( DataCoordinator& dataco, Entry_t entry, int ithread ) > EventFunc_t;
+
+    ParallelEventLoop( DataCoordinator& source, int nthreads );
+    virtual ~ParallelEventLoop() {};
+
+    void set_chunk_size( int nentries ) { fChunkSize = nentries; }; ///< largest number of entries handed out at once
+    int nthreads() const { return fNThreads; };
+
+    /// process entries [start,end) of the driver's index. end<0 means all entries.
+    void run( EventFunc_t func, std::string ftype_driver="larcv", Entry_t start=0, Entry_t end=-1 );
+
+    /// guard for user state shared between threads
+    std::mutex& output_mutex() { return fOutputMutex; };
+
+  protected:
+
+    struct WorkQueue {
+      std::mutex lock;
+      std::deque<EntryRange> chunks;
+    };
+
+    bool next_chunk( int ithread, EntryRange& chunk ); ///< own queue first, then steal
+    void worker_loop( DataCoordinator* worker, EventFunc_t func, std::string ftype_driver, int ithread );
+
+    DataCoordinator& fSource;
+    int fNThreads;
+    int fChunkSize;
+    std::vector< std::unique_ptr<WorkQueue> > fQueues;
+    std::mutex fOutputMutex;
+    std::mutex fErrorMutex;
+    std::string fError;
+  };
+
+  // per-thread result buffers, filled without locking and joined after the loop
+  template <class T>
+  class ResultCollector {
+  public:
+    ResultCollector( int nthreads ) : fBuffers( nthreads ) {};
+    void add( int ithread, const T& result ) { fBuffers.at(ithread).push_back( result ); };
+    std::vector<T> merged() const {
+      std::vector<T> all;
+      for ( auto const& buffer : fBuffers ) all.insert( all.end(), buffer.begin(), buffer.end() );
+      return all;
+    };
+  protected:
+    std::vector< std::vector<T> > fBuffers;
+  };
+
+}
+
+#endif
@@ -0,0 +1,296 @@
+#include "PipelinedEventLoop.h"
+#include "FileManager.h"
+#include "IndexSummary.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <typeinfo>
+#include "TClass.h"
+#include "TBufferFile.h"
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+#include "TROOT.h"
+#endif
+
+namespace larlitecv {
+
+  static double seconds_since( const std::chrono::steady_clock::time_point& start ) {
+    return std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+  }
+
+  PipelinedEventLoop::PipelinedEventLoop( DataCoordinator& source, int depth )
+    : fSource(source), fDepth(depth), fFree(nullptr), fLoaded(nullptr), fDone(nullptr), fAbort(false)
+  {
+    if ( fDepth<1 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " need a pipeline depth of at least one, got " << depth << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    fStats = Stats();
+  }
+
+  bool PipelinedEventLoop::push( SPSCQueue<Item>& queue, const Item& item, double& stall ) {
+    if ( queue.try_push( item ) ) return true;
+    auto start = std::chrono::steady_clock::now();
+    bool pushed = queue.push_wait( item, fAbort );
+    stall += seconds_since( start );
+    return pushed;
+  }
+
+  bool PipelinedEventLoop::pop( SPSCQueue<Item>& queue, Item& item, double& stall ) {
+    if ( queue.try_pop( item ) ) return true;
+    auto start = std::chrono::steady_clock::now();
+    bool popped = queue.pop_wait( item, fAbort );
+    stall += seconds_since( start );
+    return popped;
+  }
+
+  void PipelinedEventLoop::fail( const std::string& msg ) {
+    std::lock_guard<std::mutex> guard( fErrorMutex );
+    if ( fError=="" ) fError = msg;
+    fAbort.store( true );
+    fFree->wake_all();
+    fLoaded->wake_all();
+    fDone->wake_all();
+  }
+
+  void PipelinedEventLoop::add_product( const ProductLabel& label ) {
+    for ( auto const& other : fProducts ) {
+      if ( other.key()==label.key() ) return;
+    }
+    fProducts.push_back( label );
+  }
+
+  // deep copy through the class's streamer, as when writing to and reading from a file
+  static void copy_product( TClass* cl, void* from, void* to, TBufferFile& buffer ) {
+    buffer.Reset();
+    buffer.SetWriteMode();
+    cl->Streamer( from, buffer );
+    buffer.SetReadMode();
+    buffer.SetBufferOffset( 0 );
+    cl->Streamer( to, buffer );
+  }
+
+  void PipelinedEventLoop::read_stage( DataCoordinator& reader, std::string ftype_driver, Entry_t start, Entry_t end ) {
+    double unused = 0;
+    TBufferFile buffer( TBuffer::kWrite );
+    try {
+      for ( Entry_t entry=start; entry<end; entry++ ) {
+	Item item;
+	if ( !pop( *fFree, item, fStats.read_stall ) ) return;
+	auto t0 = std::chrono::steady_clock::now();
+	reader.goto_entry( entry, ftype_driver );
+
+	Slot& slot = fSlots[item.slot];
+	slot.products.clear();
+	slot.products.entry = entry;
+	reader.get_id( slot.products.run, slot.products.subrun, slot.products.event );
+	for ( size_t iprod=0; iprod<fProducts.size(); iprod++ ) {
+	  const ProductLabel& label = fProducts[iprod];
+	  void* base = nullptr;
+	  void* whole = nullptr;
+	  TClass* cl = nullptr;
+	  if ( label.ftype=="larlite" ) {
+	    larlite::event_base* product = reader.get_larlite_data( (larlite::data::DataType_t)label.type, label.producer );
+	    if ( product!=nullptr ) { base = product; whole = dynamic_cast<void*>( product ); cl = TClass::GetClass( typeid(*product) ); }
+	  }
+	  else {
+	    larcv::EventBase* product = reader.get_larcv_data( (larcv::ProductType_t)label.type, label.producer );
+	    if ( product!=nullptr ) { base = product; whole = dynamic_cast<void*>( product ); cl = TClass::GetClass( typeid(*product) ); }
+	  }
+	  if ( base==nullptr || cl==nullptr ) {
+	    std::stringstream ss;
+	    ss << __FILE__ << ":" << __LINE__ << " could not read product " << label.key() << " of entry " << entry << std::endl;
+	    throw std::runtime_error( ss.str() );
+	  }
+	  if ( fClasses[iprod]==nullptr ) {
+	    fClasses[iprod] = cl;
+	    fBaseOffset[iprod] = (char*)base - (char*)whole;
+	  }
+	  if ( slot.objects[iprod]==nullptr ) slot.objects[iprod] = cl->New();
+	  copy_product( cl, whole, slot.objects[iprod], buffer );
+	  slot.products.add( label, (char*)slot.objects[iprod] + fBaseOffset[iprod] );
+	}
+	fStats.read += seconds_since( t0 );
+
+	item.entry = entry;
+	item.save  = false;
+	if ( !push( *fLoaded, item, unused ) ) return;
+      }
+      Item last = { -1, -1, false };
+      push( *fLoaded, last, unused );
+    }
+    catch ( std::exception& e ) {
+      fail( e.what() );
+    }
+  }
+
+  void PipelinedEventLoop::write_stage( larlite::storage_manager* larlite_out, larcv::IOManager* larcv_out ) {
+    double unused = 0;
+    TBufferFile buffer( TBuffer::kWrite );
+    try {
+      Item item;
+      while ( pop( *fDone, item, fStats.write_stall ) ) {
+	if ( item.entry<0 ) return;
+	if ( item.save ) {
+	  auto t0 = std::chrono::steady_clock::now();
+	  const Slot& slot = fSlots[item.slot];
+	  for ( size_t iprod=0; iprod<fProducts.size(); iprod++ ) {
+	    const ProductLabel& label = fProducts[iprod];
+	    void* whole = nullptr;
+	    if ( label.ftype=="larlite" && larlite_out!=nullptr )
+	      whole = dynamic_cast<void*>( larlite_out->get_data( (larlite::data::DataType_t)label.type, label.producer ) );
+	    else if ( label.ftype=="larcv" && larcv_out!=nullptr )
+	      whole = dynamic_cast<void*>( larcv_out->get_data( (larcv::ProductType_t)label.type, label.producer ) );
+	    if ( whole!=nullptr ) copy_product( fClasses[iprod], slot.objects[iprod], whole, buffer );
+	  }
+	  const EventProducts& products = slot.products;
+	  if ( larcv_out!=nullptr ) {
+	    larcv_out->set_id( products.run, products.subrun, products.event );
+	    larcv_out->save_entry();
+	  }
+	  if ( larlite_out!=nullptr ) {
+	    larlite_out->set_id( products.run, products.subrun, products.event );
+	    larlite_out->next_event(true);
+	  }
+	  fSavedRSE.push_back( RSE( products.run, products.subrun, products.event ) );
+	  fStats.write += seconds_since( t0 );
+	  fStats.nsaved++;
+	}
+	if ( !push( *fFree, item, unused ) ) return;
+      }
+    }
+    catch ( std::exception& e ) {
+      fail( e.what() );
+    }
+  }
+
+  void PipelinedEventLoop::run( EventFunc_t func, std::string ftype_driver, Entry_t start, Entry_t end ) {
+
+    if ( fProducts.empty() ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " no products declared: use add_product()" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    fSource.initialize_index();
+    if ( fSource.get_filemanager( ftype_driver )==nullptr ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " no index for driver '" << ftype_driver << "'" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    Entry_t nentries = fSource.get_nentries( ftype_driver );
+    if ( end<0 || end>nentries ) end = nentries;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+    ROOT::EnableThreadSafety();
+#endif
+
+    // the reader opens the inputs, read-only
+    DataCoordinator reader;
+    reader.share_index( fSource );
+    reader.set_read_only();
+    reader.initialize();
+
+    // the writer: one output per file type, write-only
+    std::string larlite_file = fSource.get_outputfile("larlite");
+    std::string larcv_file   = fSource.get_outputfile("larcv");
+    larlite::storage_manager* larlite_out = nullptr;
+    larcv::IOManager* larcv_out = nullptr;
+    if ( larlite_file!="" ) {
+      larlite_out = new larlite::storage_manager( larlite::storage_manager::kWRITE );
+      larlite_out->set_out_filename( larlite_file );
+      larlite_out->open();
+    }
+    if ( larcv_file!="" ) {
+      larcv_out = new larcv::IOManager( larcv::IOManager::kWRITE );
+      larcv_out->configure( DataCoordinator::with_iomode( fSource.get_larcv_pset(), 1 ) );
+      larcv_out->set_out_file( larcv_file );
+      larcv_out->initialize();
+    }
+
+    fClasses.assign( fProducts.size(), nullptr );
+    fBaseOffset.assign( fProducts.size(), 0 );
+    fSlots.assign( fDepth, Slot() );
+    for ( auto& slot : fSlots ) slot.objects.assign( fProducts.size(), nullptr );
+
+    // every queue can hold all the slots plus the end marker, so only taking a free slot ever waits
+    fFree   = new SPSCQueue<Item>( fDepth+1 );
+    fLoaded = new SPSCQueue<Item>( fDepth+1 );
+    fDone   = new SPSCQueue<Item>( fDepth+1 );
+    for ( int islot=0; islot<fDepth; islot++ ) {
+      Item item = { islot, -1, false };
+      fFree->try_push( item );
+    }
+    fStats = Stats();
+    fSavedRSE.clear();
+    fAbort.store( false );
+    fError = "";
+
+    std::thread reading( &PipelinedEventLoop::read_stage, this, std::ref(reader), ftype_driver, start, end );
+    std::thread writing( &PipelinedEventLoop::write_stage, this, larlite_out, larcv_out );
+
+    // entries arrive in entry order: every stage keeps the order it was handed
+    double unused = 0;
+    try {
+      Item item;
+      while ( pop( *fLoaded, item, fStats.process_stall ) ) {
+	if ( item.entry>=0 ) {
+	  auto t0 = std::chrono::steady_clock::now();
+	  item.save = func( fSlots[item.slot].products );
+	  fStats.process += seconds_since( t0 );
+	  fStats.nentries++;
+	}
+	if ( !push( *fDone, item, unused ) || item.entry<0 ) break;
+      }
+    }
+    catch ( std::exception& e ) {
+      fail( e.what() );
+    }
+    reading.join();
+    writing.join();
+
+    reader.finalize();
+    if ( larlite_out!=nullptr ) {
+      larlite_out->close();
+      delete larlite_out;
+    }
+    if ( larcv_out!=nullptr ) {
+      larcv_out->finalize();
+      delete larcv_out;
+    }
+    for ( auto& slot : fSlots ) {
+      for ( size_t iprod=0; iprod<fProducts.size(); iprod++ ) {
+	if ( slot.objects[iprod]!=nullptr ) fClasses[iprod]->Destructor( slot.objects[iprod] );
+      }
+    }
+    fSlots.clear();
+    delete fFree;
+    delete fLoaded;
+    delete fDone;
+    fFree = fLoaded = fDone = nullptr;
+
+    if ( fError!="" ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " pipeline stopped: " << fError << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+
+    // as DataCoordinator does for the files it writes
+    std::string outfiles[2] = { larlite_file, larcv_file };
+    for ( int itype=0; itype<2; itype++ ) {
+      if ( outfiles[itype]=="" || fSavedRSE.size()==0 ) continue;
+      if ( !IndexSummary::write( outfiles[itype], fSavedRSE ) )
+	std::cout << "[PipelinedEventLoop] could not write index summary into " << outfiles[itype] << std::endl;
+    }
+  }
+
+  void PipelinedEventLoop::print_stats() const {
+    std::cout << "[PipelinedEventLoop] " << fStats.nentries << " entries, " << fStats.nsaved << " saved, depth " << fDepth << std::endl;
+    std::cout << "  read:    " << fStats.read    << " s, waiting for a free slot " << fStats.read_stall << " s" << std::endl;
+    std::cout << "  process: " << fStats.process << " s, waiting for an entry " << fStats.process_stall << " s" << std::endl;
+    std::cout << "  write:   " << fStats.write   << " s, waiting for an entry " << fStats.write_stall << " s" << std::endl;
+  }
+
+}
@@ -0,0 +1,178 @@
+#ifndef __PIPELINED_EVENT_LOOP__
+#define __PIPELINED_EVENT_LOOP__
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstddef>
+
+#include "FileManagerTypes.h"
+#include "DataCoordinator.h"
+#include "ProcessorBase.h"
+
+class TClass;
+
+namespace larlitecv {
+
+  // bounded single-producer/single-consumer ring. lock free: one thread pushes, one other thread pops.
+  // a side that finds the ring full (empty) can wait in push_wait (pop_wait): it spins briefly, then
+  // sleeps until the other side moves, so a stalled stage does not hold a core.
+  template <class T>
+  class SPSCQueue {
+  public:
+    SPSCQueue( size_t capacity ) : fBuffer( capacity+1 ), fHead(0), fTail(0), fWaiting(0) {};
+    bool try_push( const T& item ) {
+      if ( !put( item ) ) return false;
+      wake();
+      return true;
+    };
+    bool try_pop( T& item ) {
+      if ( !take( item ) ) return false;
+      wake();
+      return true;
+    };
+    /// false if stop was set before the item could be pushed (popped)
+    bool push_wait( const T& item, const std::atomic<bool>& stop ) { return wait( [&]() { return put( item ); }, stop ); };
+    bool pop_wait( T& item, const std::atomic<bool>& stop )        { return wait( [&]() { return take( item ); }, stop ); };
+    void wake_all() { std::lock_guard<std::mutex> guard( fMutex ); fCond.notify_all(); }; ///< after setting stop
+  protected:
+    bool put( const T& item ) {
+      size_t tail = fTail.load( std::memory_order_relaxed );
+      size_t next = ( tail+1 )%fBuffer.size();
+      if ( next==fHead.load( std::memory_order_acquire ) ) return false; // full
+      fBuffer[tail] = item;
+      fTail.store( next, std::memory_order_release );
+      return true;
+    };
+    bool take( T& item ) {
+      size_t head = fHead.load( std::memory_order_relaxed );
+      if ( head==fTail.load( std::memory_order_acquire ) ) return false; // empty
+      item = fBuffer[head];
+      fHead.store( ( head+1 )%fBuffer.size(), std::memory_order_release );
+      return true;
+    };
+    void wake() {
+      // pairs with the fence in wait(): either the sleeper sees our move, or we see the sleeper
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      if ( fWaiting.load( std::memory_order_relaxed )>0 ) wake_all();
+    };
+    template <class F> bool wait( F attempt, const std::atomic<bool>& stop ) {
+      for ( int ispin=0; ispin<64; ispin++ ) {
+	if ( attempt() ) { wake(); return true; }
+	if ( stop.load() ) return false;
+	std::this_thread::yield();
+      }
+      bool done = false;
+      {
+	std::unique_lock<std::mutex> lock( fMutex );
+	fWaiting.fetch_add( 1 );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	// the timeout only bounds how long a stop goes unnoticed if nobody calls wake_all()
+	while ( !( done = attempt() ) && !stop.load() )
+	  fCond.wait_for( lock, std::chrono::milliseconds(10) );
+	fWaiting.fetch_sub( 1 );
+      }
+      if ( done ) wake();
+      return done;
+    };
+    std::vector<T> fBuffer;
+    std::atomic<size_t> fHead; ///< next to pop
+    std::atomic<size_t> fTail; ///< next to push
+    std::atomic<int> fWaiting; ///< threads asleep in wait()
+    std::mutex fMutex;
+    std::condition_variable fCond;
+  };
+
+  // Overlaps reading, processing and writing for a single-threaded user function.
+  //
+  // Three stages run at the same time, connected by bounded lock-free queues:
+  //   read:    (own thread) one read-only DataCoordinator, sharing the source's index, goes to the
+  //            next entry and copies the declared products into a free slot
+  //   process: (calling thread) the user function, on the slot's products. it returns true if the entry is to be saved
+  //   write:   (own thread) commits the saved entries, in entry order, to the source's output files and hands the slot back
+  // So each input is opened once, by the reader, and each output is written once, by the writer.
+  // With `depth` slots at most depth entries are in flight: a stage that gets ahead waits for a slot to come back.
+  //
+  // Only the declared products travel through the pipeline, and only they are written out. The user
+  // function may change them in place. They are copied in memory with their ROOT streamers.
+  //
+  // Usage:
+  //   dataco.configure(...); dataco.set_filelist(...);  // outputs configured as for an IOMode 2 job
+  //   PipelinedEventLoop loop( dataco, 4 );
+  //   loop.add_product( ProductLabel::larlite_product( larlite::data::kMCTruth, "generator" ) );
+  //   loop.run( [&]( EventProducts& products ) { ...; return passes; } );
+  //   loop.print_stats();
+
+  class PipelinedEventLoop {
+
+  public:
+
+    typedef std::function< bool( EventProducts& products ) > EventFunc_t;
+
+    // seconds each stage spent working and waiting on its neighbours
+    struct Stats {
+      double read, process, write;
+      double read_stall;    ///< reader waiting for a free slot: processing or writing is the bottleneck
+      double process_stall; ///< user function waiting for a loaded entry: reading is the bottleneck
+      double write_stall;   ///< writer waiting for a processed entry
+      Entry_t nentries, nsaved;
+    };
+
+    PipelinedEventLoop( DataCoordinator& source, int depth=4 );
+    virtual ~PipelinedEventLoop() {};
+
+    void add_product( const ProductLabel& label ); ///< a product to read, hand to the user function and write
+    int depth() const { return fDepth; };
+
+    /// process entries [start,end) of the driver's index. end<0 means all entries.
+    void run( EventFunc_t func, std::string ftype_driver="larcv", Entry_t start=0, Entry_t end=-1 );
+
+    const Stats& stats() const { return fStats; };
+    void print_stats() const;
+
+  protected:
+
+    struct Item {
+      int slot;
+      Entry_t entry; ///< -1: no more entries
+      bool save;
+    };
+
+    // one entry in flight: our own copy of each declared product
+    struct Slot {
+      EventProducts products;
+      std::vector< void* > objects; ///< whole product objects, in fProducts order. nullptr until first used
+    };
+
+    // blocking push/pop: the time spent waiting is added to stall. false if the loop is being aborted.
+    bool push( SPSCQueue<Item>& queue, const Item& item, double& stall );
+    bool pop( SPSCQueue<Item>& queue, Item& item, double& stall );
+
+    void read_stage( DataCoordinator& reader, std::string ftype_driver, Entry_t start, Entry_t end );
+    void write_stage( larlite::storage_manager* larlite_out, larcv::IOManager* larcv_out );
+    void fail( const std::string& msg );
+
+    DataCoordinator& fSource;
+    int fDepth;
+    Stats fStats;
+    std::vector< ProductLabel > fProducts;
+    std::vector< TClass* > fClasses;      ///< class of each product, set when the reader first sees it
+    std::vector< ptrdiff_t > fBaseOffset; ///< where the event_base/EventBase part sits in each product object
+    std::vector< Slot > fSlots;
+    SPSCQueue<Item>* fFree;     ///< writer -> reader
+    SPSCQueue<Item>* fLoaded;   ///< reader -> process
+    SPSCQueue<Item>* fDone;     ///< process -> writer
+    RSElist fSavedRSE;          ///< RSE of every saved entry, for the outputs' index summaries
+    std::atomic<bool> fAbort;
+    std::mutex fErrorMutex;
+    std::string fError;
+  };
+
+}
+
+#endif
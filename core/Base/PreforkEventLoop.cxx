@@ -0,0 +1,212 @@
+#include "PreforkEventLoop.h"
+#include "FileManager.h"
+#include "OutputMerger.h"
+#include "ShardPlanner.h"
+#include "EventCostTable.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <csignal>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace larlitecv {
+
+  // messages are two int64s, well below PIPE_BUF, so writes from different workers never interleave
+  //   parent -> worker: { start, end }     start<0: no more work
+  //   worker -> parent: { iworker, status }  status 0: ready for a chunk, -1: failed
+  static bool write_pair( int fd, int64_t a, int64_t b ) {
+    int64_t msg[2] = { a, b };
+    ssize_t n;
+    do { n = write( fd, msg, sizeof(msg) ); } while ( n<0 && errno==EINTR );
+    return n==(ssize_t)sizeof(msg);
+  }
+
+  static bool read_pair( int fd, int64_t& a, int64_t& b ) {
+    int64_t msg[2];
+    size_t got = 0;
+    while ( got<sizeof(msg) ) {
+      ssize_t n = read( fd, (char*)msg+got, sizeof(msg)-got );
+      if ( n<0 && errno==EINTR ) continue;
+      if ( n<=0 ) return false;
+      got += (size_t)n;
+    }
+    a = msg[0];
+    b = msg[1];
+    return true;
+  }
+
+  PreforkEventLoop::PreforkEventLoop( DataCoordinator& source, int nworkers )
+    : fSource(source), fNWorkers(nworkers), fChunkSize(100)
+  {
+    if ( fNWorkers<1 ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " need at least one worker, got " << nworkers << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+  }
+
+  bool PreforkEventLoop::next_chunk( int iworker, EntryRange& chunk ) {
+    if ( !fQueues[iworker].empty() ) {
+      chunk = fQueues[iworker].front();
+      fQueues[iworker].pop_front();
+      return true;
+    }
+    // take from the back of the fullest queue
+    int victim = -1;
+    size_t most = 0;
+    for ( int iqueue=0; iqueue<fNWorkers; iqueue++ ) {
+      if ( fQueues[iqueue].size()>most ) {
+	most = fQueues[iqueue].size();
+	victim = iqueue;
+      }
+    }
+    if ( victim<0 ) return false;
+    chunk = fQueues[victim].back();
+    fQueues[victim].pop_back();
+    return true;
+  }
+
+  void PreforkEventLoop::worker_main( EventFunc_t func, const std::string& ftype_driver, int iworker, int task_fd, int result_fd ) {
+    // we are in the child. fSource and its index are our private copy-on-write view of the parent's.
+    DataCoordinator worker;
+    worker.share_index( fSource );
+    std::string ftypes[2] = { "larlite", "larcv" };
+    for ( int itype=0; itype<2; itype++ ) {
+      if ( fOutfiles[itype]!="" )
+	worker.set_outputfile( OutputMerger::worker_filename( fOutfiles[itype], "p", iworker ), ftypes[itype] );
+    }
+    if ( fSource.get_cost_sidecar()!="" )
+      worker.record_event_costs( OutputMerger::worker_filename( fSource.get_cost_sidecar(), "p", iworker ) );
+    worker.initialize();
+
+    write_pair( result_fd, iworker, 0 );
+    int64_t start, end;
+    while ( read_pair( task_fd, start, end ) && start>=0 ) {
+      for ( Entry_t entry=start; entry<end; entry++ ) {
+	worker.goto_entry( entry, ftype_driver );
+	func( worker, entry, iworker );
+      }
+      write_pair( result_fd, iworker, 0 );
+    }
+    worker.finalize();
+  }
+
+  void PreforkEventLoop::run( EventFunc_t func, std::string ftype_driver, Entry_t start, Entry_t end ) {
+
+    fSource.initialize_index();
+    if ( fSource.get_filemanager( ftype_driver )==nullptr ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " no index for driver '" << ftype_driver << "'" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    Entry_t nentries = fSource.get_nentries( ftype_driver );
+    if ( end<0 || end>nentries ) end = nentries;
+
+    std::vector<EntryRange> chunks = ShardPlanner::make_chunks( *fSource.get_filemanager( ftype_driver ), fSource.get_event_costs(), start, end, fChunkSize );
+    fQueues.assign( fNWorkers, std::deque<EntryRange>() );
+    for ( size_t ichunk=0; ichunk<chunks.size(); ichunk++ )
+      fQueues[ ichunk*fNWorkers/chunks.size() ].push_back( chunks[ichunk] );
+
+    fOutfiles.clear();
+    fOutfiles.push_back( fSource.get_outputfile("larlite") );
+    fOutfiles.push_back( fSource.get_outputfile("larcv") );
+
+    int result_pipe[2];
+    if ( pipe( result_pipe )!=0 )
+      throw std::runtime_error( "PreforkEventLoop: could not create result pipe" );
+
+    // a worker that died would otherwise take the parent down with it on the next write
+    void (*old_sigpipe)(int) = signal( SIGPIPE, SIG_IGN );
+
+    std::cout.flush(); // or buffered output is printed by every child
+    std::vector<pid_t> pids;
+    std::vector<int> task_fds;
+    for ( int iworker=0; iworker<fNWorkers; iworker++ ) {
+      int task_pipe[2];
+      if ( pipe( task_pipe )!=0 )
+	throw std::runtime_error( "PreforkEventLoop: could not create task pipe" );
+      pid_t pid = fork();
+      if ( pid<0 )
+	throw std::runtime_error( "PreforkEventLoop: fork failed" );
+      if ( pid==0 ) {
+	close( result_pipe[0] );
+	close( task_pipe[1] );
+	for ( auto const& fd : task_fds ) close( fd );
+	int status = 0;
+	try {
+	  worker_main( func, ftype_driver, iworker, task_pipe[0], result_pipe[1] );
+	}
+	catch ( std::exception& e ) {
+	  std::cout << "[PreforkEventLoop] worker " << iworker << " failed: " << e.what() << std::endl;
+	  write_pair( result_pipe[1], iworker, -1 );
+	  status = 1;
+	}
+	std::cout.flush();
+	_exit( status ); // skip the parent's atexit handlers and static destructors
+      }
+      close( task_pipe[0] );
+      pids.push_back( pid );
+      task_fds.push_back( task_pipe[1] );
+    }
+    close( result_pipe[1] );
+
+    // dispatch chunks until every worker has been told to stop (or has gone away)
+    int nactive = fNWorkers;
+    bool failed = false;
+    int64_t iworker, status;
+    while ( nactive>0 && read_pair( result_pipe[0], iworker, status ) ) {
+      if ( iworker<0 || iworker>=fNWorkers ) continue;
+      EntryRange chunk;
+      if ( status==0 && !failed && next_chunk( iworker, chunk ) ) {
+	write_pair( task_fds[iworker], chunk.start, chunk.end );
+	continue;
+      }
+      if ( status!=0 ) failed = true;
+      else write_pair( task_fds[iworker], -1, -1 );
+      close( task_fds[iworker] );
+      task_fds[iworker] = -1;
+      nactive--;
+    }
+    close( result_pipe[0] );
+    for ( auto const& fd : task_fds ) {
+      if ( fd>=0 ) close( fd );
+    }
+
+    for ( auto const& pid : pids ) {
+      int wstatus = 0;
+      while ( waitpid( pid, &wstatus, 0 )<0 && errno==EINTR ) {}
+      if ( !WIFEXITED(wstatus) || WEXITSTATUS(wstatus)!=0 ) failed = true;
+    }
+    signal( SIGPIPE, old_sigpipe );
+
+    if ( failed ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " one or more workers failed." << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+
+    // combine per-worker outputs
+    std::string ftypes[2] = { "larlite", "larcv" };
+    for ( int itype=0; itype<2; itype++ ) {
+      if ( fOutfiles[itype]=="" ) continue;
+      std::vector<std::string> inputs;
+      for ( int iw=0; iw<fNWorkers; iw++ ) inputs.push_back( OutputMerger::worker_filename( fOutfiles[itype], "p", iw ) );
+      if ( !OutputMerger::merge( inputs, fOutfiles[itype] ) ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " could not merge " << ftypes[itype] << " outputs into " << fOutfiles[itype] << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+    }
+
+    if ( fSource.get_cost_sidecar()!="" ) {
+      std::vector<std::string> sidecars;
+      for ( int iw=0; iw<fNWorkers; iw++ ) sidecars.push_back( OutputMerger::worker_filename( fSource.get_cost_sidecar(), "p", iw ) );
+      if ( !EventCostTable::merge_files( sidecars, fSource.get_cost_sidecar() ) )
+	std::cout << "[PreforkEventLoop] could not write event costs to " << fSource.get_cost_sidecar() << std::endl;
+    }
+  }
+
+}
@@ -0,0 +1,60 @@
+#ifndef __PREFORK_EVENT_LOOP__
+#define __PREFORK_EVENT_LOOP__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <sys/types.h>
+
+#include "FileManagerTypes.h"
+#include "DataCoordinator.h"
+
+namespace larlitecv {
+
+  // Process-based counterpart of ParallelEventLoop, for user code that is not thread-safe.
+  //
+  // The source DataCoordinator builds its index once. N worker processes are forked from it and
+  // inherit the index copy-on-write, so nothing is re-indexed. Each worker opens its own readers
+  // and receives entry ranges (chunks inside one file block) from the parent over a pipe, asking for
+  // more when done. The parent hands out chunks from per-worker queues and lets idle workers take
+  // chunks from the back of the fullest queue.
+  //
+  // Outputs: each worker writes out.root -> out_p<i>.root, merged into the configured files at the end.
+  // Event costs are used and recorded as in ParallelEventLoop.
+  //
+  // Usage is the same as ParallelEventLoop:
+  //   dataco.initialize_index();
+  //   PreforkEventLoop loop( dataco, 8 );
+  //   loop.run( []( DataCoordinator& worker, Entry_t entry, int iworker ) { ... } );
+
+  class PreforkEventLoop {
+
+  public:
+
+    typedef std::function< void( DataCoordinator& dataco, Entry_t entry, int iworker ) > EventFunc_t;
+
+    PreforkEventLoop( DataCoordinator& source, int nworkers );
+    virtual ~PreforkEventLoop() {};
+
+    void set_chunk_size( int nentries ) { fChunkSize = nentries; }; ///< largest number of entries handed out at once
+    int nworkers() const { return fNWorkers; };
+
+    /// process entries [start,end) of the driver's index. end<0 means all entries.
+    void run( EventFunc_t func, std::string ftype_driver="larcv", Entry_t start=0, Entry_t end=-1 );
+
+  protected:
+
+    bool next_chunk( int iworker, EntryRange& chunk );
+    void worker_main( EventFunc_t func, const std::string& ftype_driver, int iworker, int task_fd, int result_fd );
+
+    DataCoordinator& fSource;
+    int fNWorkers;
+    int fChunkSize;
+    std::vector< std::deque<EntryRange> > fQueues;
+    std::vector< std::string > fOutfiles;
+  };
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include "ProcessorBase.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace larlitecv {
+
+  ProductLabel ProductLabel::larlite_product( larlite::data::DataType_t type, std::string producer ) {
+    ProductLabel label;
+    label.ftype    = "larlite";
+    label.type     = (int)type;
+    label.producer = producer;
+    return label;
+  }
+
+  ProductLabel ProductLabel::larcv_product( larcv::ProductType_t type, std::string producer ) {
+    ProductLabel label;
+    label.ftype    = "larcv";
+    label.type     = (int)type;
+    label.producer = producer;
+    return label;
+  }
+
+  std::string ProductLabel::key() const {
+    std::stringstream ss;
+    ss << ftype << ":" << type << ":" << producer;
+    return ss.str();
+  }
+
+  void* EventProducts::find( const ProductLabel& label ) const {
+    auto iter = fProducts.find( label.key() );
+    if ( iter==fProducts.end() ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " product " << label.key() << " was not declared by any processor" << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+    return iter->second;
+  }
+
+  larlite::event_base* EventProducts::get_larlite_data( larlite::data::DataType_t type, std::string producer ) const {
+    return (larlite::event_base*)find( ProductLabel::larlite_product( type, producer ) );
+  }
+
+  larcv::EventBase* EventProducts::get_larcv_data( larcv::ProductType_t type, std::string producer ) const {
+    return (larcv::EventBase*)find( ProductLabel::larcv_product( type, producer ) );
+  }
+
+}
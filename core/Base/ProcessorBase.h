@@ -0,0 +1,85 @@
+#ifndef __PROCESSOR_BASE__
+#define __PROCESSOR_BASE__
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "FileManagerTypes.h"
+#include "DataFormat/DataFormatTypes.h"
+#include "DataFormat/data_base.h"
+#include "DataFormat/EventBase.h"
+#include "Base/PSet.h"
+
+namespace larlitecv {
+
+  // one larlite or larcv product, by type and producer
+  class ProductLabel {
+  public:
+    ProductLabel() : ftype(""), type(-1), producer("") {};
+    static ProductLabel larlite_product( larlite::data::DataType_t type, std::string producer );
+    static ProductLabel larcv_product( larcv::ProductType_t type, std::string producer );
+    std::string key() const; ///< "<ftype>:<type>:<producer>"
+
+    std::string ftype; ///< "larlite" or "larcv"
+    int type;
+    std::string producer;
+  };
+
+  // the products a processor declared, for the current event. filled by ProcessorChain.
+  class EventProducts {
+  public:
+    EventProducts() : entry(-1), run(0), subrun(0), event(0) {};
+
+    /// throws if the product was not declared by the calling processor (or one before it)
+    larlite::event_base* get_larlite_data( larlite::data::DataType_t type, std::string producer ) const;
+    larcv::EventBase* get_larcv_data( larcv::ProductType_t type, std::string producer ) const;
+
+    bool has( const ProductLabel& label ) const { return fProducts.find( label.key() )!=fProducts.end(); };
+    void add( const ProductLabel& label, void* product ) { fProducts[label.key()] = product; };
+    void clear() { fProducts.clear(); };
+
+    Entry_t entry;
+    int run, subrun, event;
+
+  protected:
+    void* find( const ProductLabel& label ) const;
+    std::map< std::string, void* > fProducts;
+  };
+
+  // A module of a ProcessorChain.
+  //
+  // A processor declares the products it reads (consumes) and writes (produces), usually in its
+  // constructor. A processor consuming a product another one produces runs after it; processors
+  // with no such relation may run at the same time on the same event. Return true from
+  // thread_safe() if process() may also run on several events at once.
+  class ProcessorBase {
+
+  public:
+
+    ProcessorBase( std::string name ) : fName(name) {};
+    virtual ~ProcessorBase() {};
+
+    const std::string& name() const { return fName; };
+    const std::vector<ProductLabel>& inputs() const { return fInputs; };
+    const std::vector<ProductLabel>& outputs() const { return fOutputs; };
+
+    virtual void configure( const larcv::PSet& pset ) { (void)pset; }; ///< called with the block named after the processor, if the chain's configuration has one
+    virtual void initialize() {};
+    virtual bool process( const EventProducts& products )=0; ///< false drops the event: later processors are skipped and it is not saved
+    virtual void finalize() {};
+    virtual bool thread_safe() const { return false; };
+
+  protected:
+
+    void consumes( const ProductLabel& label ) { fInputs.push_back( label ); };
+    void produces( const ProductLabel& label ) { fOutputs.push_back( label ); };
+
+    std::string fName;
+    std::vector<ProductLabel> fInputs;
+    std::vector<ProductLabel> fOutputs;
+  };
+
+}
+
+#endif
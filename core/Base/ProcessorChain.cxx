@@ -0,0 +1,258 @@
+#include "ProcessorChain.h"
+#include "ParallelEventLoop.h"
+#include "Base/LArCVBaseUtilFunc.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <map>
+#include <algorithm>
+
+namespace larlitecv {
+
+  ProcessorChain::ProcessorChain( DataCoordinator& dataco )
+    : fDataco(dataco), fNThreads(1), fNProcessed(0), fNSaved(0), fRunning(0), fStop(false)
+  {}
+
+  ProcessorChain::~ProcessorChain() {
+    stop_workers();
+    for ( auto& processor : fProcessors ) delete processor;
+  }
+
+  void ProcessorChain::add_processor( ProcessorBase* processor ) {
+    for ( auto const& other : fProcessors ) {
+      if ( other->name()==processor->name() ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " there is already a processor named '" << processor->name() << "'" << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+    }
+    fProcessors.push_back( processor );
+    fLevels.clear();
+  }
+
+  void ProcessorChain::configure( std::string cfgfile, std::string block ) {
+    larcv::PSet cfg = larcv::CreatePSetFromFile( cfgfile );
+    larcv::PSet chain_cfg = cfg.get<larcv::PSet>( block );
+    for ( auto& processor : fProcessors ) {
+      if ( chain_cfg.contains_pset( processor->name() ) )
+	processor->configure( chain_cfg.get<larcv::PSet>( processor->name() ) );
+    }
+  }
+
+  void ProcessorChain::schedule() {
+    // who produces what
+    std::map< std::string, int > producer_of;
+    for ( size_t iproc=0; iproc<fProcessors.size(); iproc++ ) {
+      for ( auto const& label : fProcessors[iproc]->outputs() ) {
+	auto iter = producer_of.find( label.key() );
+	if ( iter!=producer_of.end() && iter->second!=(int)iproc ) {
+	  std::stringstream ss;
+	  ss << __FILE__ << ":" << __LINE__ << " " << label.key() << " is produced by both " << fProcessors[iter->second]->name()
+	     << " and " << fProcessors[iproc]->name() << std::endl;
+	  throw std::runtime_error( ss.str() );
+	}
+	producer_of[label.key()] = (int)iproc;
+      }
+    }
+
+    // level of a processor: one more than the deepest processor it consumes from. products nobody
+    // produces come from the input files.
+    std::vector< std::vector<int> > depends( fProcessors.size() );
+    for ( size_t iproc=0; iproc<fProcessors.size(); iproc++ ) {
+      for ( auto const& label : fProcessors[iproc]->inputs() ) {
+	auto iter = producer_of.find( label.key() );
+	if ( iter!=producer_of.end() && iter->second!=(int)iproc ) depends[iproc].push_back( iter->second );
+      }
+    }
+    std::vector<int> level( fProcessors.size(), -1 );
+    size_t nplaced = 0;
+    for ( int ilevel=0; nplaced<fProcessors.size(); ilevel++ ) {
+      std::vector<int> placed;
+      for ( size_t iproc=0; iproc<fProcessors.size(); iproc++ ) {
+	if ( level[iproc]>=0 ) continue;
+	bool ready = true;
+	for ( auto const& dep : depends[iproc] ) ready = ready && level[dep]>=0 && level[dep]<ilevel;
+	if ( ready ) placed.push_back( (int)iproc );
+      }
+      if ( placed.empty() ) {
+	std::stringstream ss;
+	ss << __FILE__ << ":" << __LINE__ << " the processors' products form a cycle among:";
+	for ( size_t iproc=0; iproc<fProcessors.size(); iproc++ ) {
+	  if ( level[iproc]<0 ) ss << " " << fProcessors[iproc]->name();
+	}
+	ss << std::endl;
+	throw std::runtime_error( ss.str() );
+      }
+      for ( auto const& iproc : placed ) level[iproc] = ilevel;
+      nplaced += placed.size();
+    }
+
+    fLevels.clear();
+    for ( size_t iproc=0; iproc<fProcessors.size(); iproc++ ) {
+      if ( level[iproc]>=(int)fLevels.size() ) fLevels.resize( level[iproc]+1 );
+      fLevels[level[iproc]].push_back( (int)iproc );
+    }
+  }
+
+  void ProcessorChain::fetch( DataCoordinator& dataco, const std::vector<ProductLabel>& labels, EventProducts& products ) {
+    for ( auto const& label : labels ) {
+      if ( products.has( label ) ) continue;
+      if ( label.ftype=="larlite" )
+	products.add( label, dataco.get_larlite_data( (larlite::data::DataType_t)label.type, label.producer ) );
+      else
+	products.add( label, dataco.get_larcv_data( (larcv::ProductType_t)label.type, label.producer ) );
+    }
+  }
+
+  bool ProcessorChain::process_event( DataCoordinator& dataco, Entry_t entry, bool concurrent ) {
+    EventProducts products;
+    products.entry = entry;
+    dataco.get_id( products.run, products.subrun, products.event );
+
+    for ( auto const& level : fLevels ) {
+      for ( auto const& iproc : level ) {
+	fetch( dataco, fProcessors[iproc]->inputs(), products );
+	fetch( dataco, fProcessors[iproc]->outputs(), products );
+      }
+
+      bool accepted = true;
+      if ( !concurrent || level.size()==1 ) {
+	for ( auto const& iproc : level ) accepted = fProcessors[iproc]->process( products ) && accepted;
+      }
+      else {
+	// the first processor runs here, the others on the workers. every one finishes
+	// before an exception is passed on.
+	std::vector<char> results( level.size(), 0 );
+	std::vector<std::string> errors( level.size() );
+	for ( size_t i=1; i<level.size(); i++ ) {
+	  ProcessorBase* processor = fProcessors[level[i]];
+	  post( [processor,&products,&results,&errors,i]() {
+	      try {
+		results[i] = processor->process( products );
+	      }
+	      catch ( std::exception& e ) {
+		errors[i] = e.what();
+	      }
+	    } );
+	}
+	try {
+	  results[0] = fProcessors[level[0]]->process( products );
+	}
+	catch ( std::exception& e ) {
+	  errors[0] = e.what();
+	}
+	wait_tasks();
+	for ( size_t i=0; i<level.size(); i++ ) {
+	  if ( errors[i]!="" ) throw std::runtime_error( errors[i] );
+	  accepted = results[i] && accepted;
+	}
+      }
+      if ( !accepted ) return false;
+    }
+    return true;
+  }
+
+  void ProcessorChain::run( std::string ftype_driver, Entry_t start, Entry_t end ) {
+
+    if ( fLevels.empty() ) schedule();
+    bool all_thread_safe = true;
+    for ( auto& processor : fProcessors ) {
+      processor->initialize();
+      all_thread_safe = all_thread_safe && processor->thread_safe();
+    }
+    std::cout << "[ProcessorChain] " << fProcessors.size() << " processors in " << fLevels.size() << " levels" << std::endl;
+    for ( size_t ilevel=0; ilevel<fLevels.size(); ilevel++ ) {
+      std::cout << "  level " << ilevel << ":";
+      for ( auto const& iproc : fLevels[ilevel] ) std::cout << " " << fProcessors[iproc]->name();
+      std::cout << std::endl;
+    }
+
+    bool saving = fDataco.get_outputfile("larlite")!="" || fDataco.get_outputfile("larcv")!="";
+    fNProcessed = 0;
+    fNSaved = 0;
+
+    if ( fNThreads>1 && all_thread_safe ) {
+      ParallelEventLoop loop( fDataco, fNThreads );
+      loop.run( [this,saving]( DataCoordinator& worker, Entry_t entry, int ithread ) {
+	  (void)ithread;
+	  fNProcessed++;
+	  if ( !process_event( worker, entry, false ) ) return;
+	  if ( saving ) worker.save_entry();
+	  fNSaved++;
+	}, ftype_driver, start, end );
+    }
+    else {
+      // one worker for each processor of the widest level beyond the first
+      size_t widest = 0;
+      for ( auto const& level : fLevels ) widest = std::max( widest, level.size() );
+      if ( fNThreads>1 ) start_workers( std::min( fNThreads, (int)widest )-1 );
+      fDataco.initialize();
+      Entry_t nentries = fDataco.get_nentries( ftype_driver );
+      if ( end<0 || end>nentries ) end = nentries;
+      for ( Entry_t entry=start; entry<end; entry++ ) {
+	fDataco.goto_entry( entry, ftype_driver );
+	fNProcessed++;
+	if ( !process_event( fDataco, entry, fNThreads>1 ) ) continue;
+	if ( saving ) fDataco.save_entry();
+	fNSaved++;
+      }
+      fDataco.finalize();
+      stop_workers();
+    }
+
+    for ( auto& processor : fProcessors ) processor->finalize();
+    std::cout << "[ProcessorChain] " << fNSaved << " of " << fNProcessed << " events accepted" << std::endl;
+  }
+
+  void ProcessorChain::start_workers( int nworkers ) {
+    stop_workers();
+    fStop = false;
+    for ( int iworker=0; iworker<nworkers; iworker++ )
+      fWorkers.push_back( std::thread( &ProcessorChain::work, this ) );
+  }
+
+  void ProcessorChain::stop_workers() {
+    {
+      std::lock_guard<std::mutex> guard( fMutex );
+      fStop = true;
+    }
+    fWake.notify_all();
+    for ( auto& worker : fWorkers ) worker.join();
+    fWorkers.clear();
+  }
+
+  void ProcessorChain::work() {
+    while ( true ) {
+      std::function<void()> task;
+      {
+	std::unique_lock<std::mutex> lock( fMutex );
+	fWake.wait( lock, [this]() { return fStop || !fTasks.empty(); } );
+	if ( fTasks.empty() ) return; // stopping, and nothing left to do
+	task = fTasks.front();
+	fTasks.pop_front();
+      }
+      task(); // tasks catch their own exceptions
+      std::lock_guard<std::mutex> guard( fMutex );
+      if ( --fRunning==0 ) fIdle.notify_all();
+    }
+  }
+
+  void ProcessorChain::post( std::function<void()> task ) {
+    if ( fWorkers.empty() ) {
+      task();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> guard( fMutex );
+      fTasks.push_back( task );
+      fRunning++;
+    }
+    fWake.notify_one();
+  }
+
+  void ProcessorChain::wait_tasks() {
+    std::unique_lock<std::mutex> lock( fMutex );
+    fIdle.wait( lock, [this]() { return fRunning==0; } );
+  }
+
+}
@@ -0,0 +1,88 @@
+#ifndef __PROCESSOR_CHAIN__
+#define __PROCESSOR_CHAIN__
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+
+#include "FileManagerTypes.h"
+#include "DataCoordinator.h"
+#include "ProcessorBase.h"
+
+namespace larlitecv {
+
+  // Runs a set of processors (see ProcessorBase) over the entries of a DataCoordinator, in the
+  // spirit of larlite's ana_processor and larcv's ProcessDriver.
+  //
+  // The processors are ordered by the products they declare: one consuming a product that another
+  // produces runs in a later level. With more than one thread:
+  //  - if every processor is thread_safe(), whole events run in parallel through a ParallelEventLoop
+  //    (outputs are then grouped by thread, see ParallelEventLoop)
+  //  - otherwise events run one after another and the processors of a level run concurrently, on
+  //    worker threads started once per run(). a level of one processor runs on the calling thread.
+  // The products of a level are fetched from the DataCoordinator before the level starts, one at a
+  // time, as the IO managers are not thread safe; processors only see them through EventProducts.
+  // An event is saved if every processor accepted it and the DataCoordinator has an output file.
+  //
+  // Usage:
+  //   dataco.configure(...); dataco.set_filelist(...);
+  //   ProcessorChain chain( dataco );
+  //   chain.add_processor( new MyProcessor );   // the chain deletes its processors
+  //   chain.configure( "config.cfg", "ProcessorChain" );
+  //   chain.set_nthreads( 4 );
+  //   chain.run();
+
+  class ProcessorChain {
+
+  public:
+
+    ProcessorChain( DataCoordinator& dataco );
+    virtual ~ProcessorChain();
+    ProcessorChain( const ProcessorChain& ) = delete;
+    ProcessorChain& operator=( const ProcessorChain& ) = delete;
+
+    void add_processor( ProcessorBase* processor ); ///< names must be unique
+    void configure( std::string cfgfile, std::string block ); ///< hands each processor the sub-block named after it
+    void set_nthreads( int nthreads ) { fNThreads = nthreads; };
+
+    /// process entries [start,end) of the driver's index. end<0 means all entries.
+    void run( std::string ftype_driver="larcv", Entry_t start=0, Entry_t end=-1 );
+
+    const std::vector< std::vector<int> >& levels() const { return fLevels; }; ///< processor indices per level, once scheduled
+    void schedule(); ///< orders the processors. throws on a product with two producers or a cycle
+
+  protected:
+
+    bool process_event( DataCoordinator& dataco, Entry_t entry, bool concurrent );
+    void fetch( DataCoordinator& dataco, const std::vector<ProductLabel>& labels, EventProducts& products );
+
+    DataCoordinator& fDataco;
+    std::vector< ProcessorBase* > fProcessors;
+    std::vector< std::vector<int> > fLevels;
+    int fNThreads;
+    std::atomic<Entry_t> fNProcessed;
+    std::atomic<Entry_t> fNSaved;
+
+    // workers running all but the first processor of a level
+    void start_workers( int nworkers );
+    void stop_workers();
+    void work();
+    void post( std::function<void()> task );
+    void wait_tasks(); ///< until every posted task has finished
+    std::vector< std::thread > fWorkers;
+    std::deque< std::function<void()> > fTasks;
+    int fRunning;  ///< tasks posted and not yet finished
+    bool fStop;
+    std::mutex fMutex;
+    std::condition_variable fWake; ///< a task was posted, or the workers should stop
+    std::condition_variable fIdle; ///< fRunning dropped to 0
+  };
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "RSEOrderedIterator.h"
+#include "FileManager.h"
+#include <algorithm>
+#include <functional>
+
+namespace larlitecv {
+
+  RSEOrderedIterator::RSEOrderedIterator( const FileManager& fman )
+    : fFileManager(fman)
+  {
+    // ranges are stored in entry order. a run continues while the next range starts above
+    // where the previous one ended.
+    int64_t nranges = fman.nranges();
+    for ( int64_t irange=0; irange<nranges; irange++ ) {
+      if ( irange==0 || !( fman.range( irange-1 ).last().key()<fman.range( irange ).first().key() ) ) {
+	if ( irange>0 ) fRunEnd.push_back( irange );
+	fRunStart.push_back( irange );
+      }
+    }
+    if ( nranges>0 ) fRunEnd.push_back( nranges );
+    reset();
+  }
+
+  void RSEOrderedIterator::reset() {
+    fHeap.clear();
+    for ( size_t irun=0; irun<fRunStart.size(); irun++ ) {
+      const RSERange& range = fFileManager.range( fRunStart[irun] );
+      Cursor cursor;
+      cursor.key    = range.first().key();
+      cursor.entry  = range.first_entry;
+      cursor.irange = fRunStart[irun];
+      cursor.run    = (int)irun;
+      fHeap.push_back( cursor );
+    }
+    std::make_heap( fHeap.begin(), fHeap.end(), std::greater<Cursor>() );
+  }
+
+  bool RSEOrderedIterator::next( Entry_t& entry ) {
+    if ( fHeap.empty() ) return false;
+    std::pop_heap( fHeap.begin(), fHeap.end(), std::greater<Cursor>() );
+    Cursor& cursor = fHeap.back();
+    entry = cursor.entry;
+
+    // advance the cursor within its range, then into the next range of its run
+    const RSERange* range = &fFileManager.range( cursor.irange );
+    cursor.entry++;
+    if ( cursor.entry>=range->first_entry+range->nentries ) {
+      cursor.irange++;
+      if ( cursor.irange>=fRunEnd[cursor.run] ) {
+	fHeap.pop_back();
+	return true;
+      }
+      range = &fFileManager.range( cursor.irange );
+    }
+    cursor.key = range->at( cursor.entry ).key();
+    std::push_heap( fHeap.begin(), fHeap.end(), std::greater<Cursor>() );
+    return true;
+  }
+
+}
@@ -0,0 +1,47 @@
+#ifndef __RSE_ORDERED_ITERATOR__
+#define __RSE_ORDERED_ITERATOR__
+
+#include <vector>
+#include "FileManagerTypes.h"
+
+namespace larlitecv {
+
+  class FileManager;
+
+  // Visits the entries of a FileManager index in (run, subrun, event, subevent) order.
+  //
+  // The index table is cut into runs: stretches of consecutive entries whose RSEs already
+  // increase, which is usually one per file. The runs are then merged with a heap holding one
+  // cursor per run, so memory is O(number of runs), no entry list is sorted, and each file is
+  // read front to back. Repeated RSEs come out in entry order.
+  class RSEOrderedIterator {
+
+  public:
+
+    RSEOrderedIterator( const FileManager& fman );
+    virtual ~RSEOrderedIterator() {};
+
+    bool next( Entry_t& entry );  ///< next entry in RSE order. false once every entry has been visited.
+    void reset();                 ///< start over from the lowest RSE
+    size_t nruns() const { return fRunEnd.size(); };
+
+  protected:
+
+    struct Cursor {
+      RSEKey key;
+      Entry_t entry;
+      int64_t irange; ///< range of the table holding entry
+      int run;        ///< sorted run it belongs to
+      bool operator>( const Cursor& b ) const { return b.key<key || ( key==b.key && entry>b.entry ); };
+    };
+
+    const FileManager& fFileManager;
+    std::vector< int64_t > fRunStart; ///< first range of each sorted run
+    std::vector< int64_t > fRunEnd;   ///< one past its last range
+    std::vector< Cursor > fHeap;      ///< min-heap on (key, entry)
+
+  };
+
+}
+
+#endif
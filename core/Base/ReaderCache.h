@@ -0,0 +1,64 @@
+#ifndef __READER_CACHE__
+#define __READER_CACHE__
+
+#include <list>
+#include <utility>
+#include <functional>
+
+namespace larlitecv {
+
+  // Keeps at most capacity readers open, keyed by file block. Looking a reader up makes it the
+  // most recently used; adding one beyond capacity closes and deletes the least recently used.
+  // The cache owns the readers it holds.
+  template <class Reader>
+  class ReaderCache {
+  public:
+    typedef std::function< void( Reader* ) > Closer_t;
+
+    ReaderCache( size_t capacity=4 ) : fCapacity(capacity) {};
+    virtual ~ReaderCache() { clear(); };
+
+    void set_capacity( size_t capacity ) { fCapacity = ( capacity<1 ) ? 1 : capacity; };
+    void set_closer( Closer_t closer ) { fCloser = closer; }; ///< called on a reader before it is deleted
+
+    Reader* get( int key ) { ///< nullptr if key is not open
+      for ( auto iter=fReaders.begin(); iter!=fReaders.end(); iter++ ) {
+	if ( iter->first!=key ) continue;
+	if ( iter!=fReaders.begin() ) fReaders.splice( fReaders.begin(), fReaders, iter );
+	return fReaders.front().second;
+      }
+      return nullptr;
+    };
+
+    void put( int key, Reader* reader ) {
+      fReaders.push_front( std::make_pair( key, reader ) );
+      while ( fReaders.size()>fCapacity ) {
+	release( fReaders.back().second );
+	fReaders.pop_back();
+      }
+    };
+
+    void clear() {
+      for ( auto& iter : fReaders ) release( iter.second );
+      fReaders.clear();
+    };
+
+    size_t size() const { return fReaders.size(); };
+
+  private:
+    ReaderCache( const ReaderCache& );
+    ReaderCache& operator=( const ReaderCache& );
+
+    void release( Reader* reader ) {
+      if ( fCloser ) fCloser( reader );
+      delete reader;
+    };
+
+    size_t fCapacity;
+    Closer_t fCloser;
+    std::list< std::pair< int, Reader* > > fReaders; ///< most recently used first
+  };
+
+}
+
+#endif
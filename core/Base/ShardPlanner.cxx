@@ -0,0 +1,83 @@
+#include "ShardPlanner.h"
+#include "FileManager.h"
+#include "EventCostTable.h"
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace larlitecv {
+
+  std::vector<int> ShardPlanner::plan( const std::vector<double>& block_weights, int ishard, int nshards ) {
+
+    if ( nshards<1 || ishard<0 || ishard>=nshards ) {
+      std::stringstream ss;
+      ss << __FILE__ << ":" << __LINE__ << " invalid shard " << ishard << " of " << nshards << std::endl;
+      throw std::runtime_error( ss.str() );
+    }
+
+    double total = 0.;
+    for ( auto const& w : block_weights ) total += w;
+
+    // a block goes to the shard its weight-midpoint falls into. this keeps shards contiguous
+    // and each shard within half a block of the ideal total/nshards.
+    std::vector<int> shard_blocks;
+    double cumulative = 0.;
+    for ( int iblock=0; iblock<(int)block_weights.size(); iblock++ ) {
+      double midpoint = cumulative + 0.5*block_weights[iblock];
+      cumulative += block_weights[iblock];
+      int owner = ( total>0 ) ? (int)( midpoint*nshards/total ) : iblock%nshards;
+      if ( owner>=nshards ) owner = nshards-1;
+      if ( owner==ishard ) shard_blocks.push_back( iblock );
+    }
+
+    return shard_blocks;
+  }
+
+  std::vector<double> ShardPlanner::entry_weights( const std::vector<FileBlock>& blocks ) {
+    std::vector<double> weights;
+    weights.reserve( blocks.size() );
+    for ( auto const& block : blocks ) weights.push_back( (double)block.nentries );
+    return weights;
+  }
+
+  std::vector<EntryRange> ShardPlanner::make_chunks( const std::vector<FileBlock>& blocks, Entry_t start, Entry_t end, int chunk_size ) {
+    if ( chunk_size<1 ) chunk_size = 1;
+    std::vector<EntryRange> chunks;
+    for ( auto const& block : blocks ) {
+      Entry_t block_start = std::max( block.first_entry, start );
+      Entry_t block_end   = std::min( block.first_entry+block.nentries, end );
+      for ( Entry_t chunk_start=block_start; chunk_start<block_end; chunk_start+=chunk_size )
+	chunks.push_back( EntryRange( chunk_start, std::min( chunk_start+chunk_size, block_end ) ) );
+    }
+    return chunks;
+  }
+
+  std::vector<EntryRange> ShardPlanner::make_chunks( const std::vector<FileBlock>& blocks, Entry_t start, Entry_t end,
+						     const std::vector<double>& entry_costs, double chunk_cost ) {
+    std::vector<EntryRange> chunks;
+    for ( auto const& block : blocks ) {
+      Entry_t block_start = std::max( block.first_entry, start );
+      Entry_t block_end   = std::min( block.first_entry+block.nentries, end );
+      Entry_t chunk_start = block_start;
+      double accumulated = 0.;
+      for ( Entry_t entry=block_start; entry<block_end; entry++ ) {
+	accumulated += ( entry<(Entry_t)entry_costs.size() ) ? entry_costs[entry] : 0.;
+	if ( accumulated>=chunk_cost ) {
+	  chunks.push_back( EntryRange( chunk_start, entry+1 ) );
+	  chunk_start = entry+1;
+	  accumulated = 0.;
+	}
+      }
+      if ( chunk_start<block_end ) chunks.push_back( EntryRange( chunk_start, block_end ) );
+    }
+    return chunks;
+  }
+
+  std::vector<EntryRange> ShardPlanner::make_chunks( const FileManager& fman, const EventCostTable& costs, Entry_t start, Entry_t end, int chunk_size ) {
+    double chunk_cost = costs.mean()*chunk_size;
+    if ( costs.size()==0 || chunk_cost<=0 )
+      return make_chunks( fman.get_fileblocks(), start, end, chunk_size );
+    return make_chunks( fman.get_fileblocks(), start, end, costs.entry_costs( fman ), chunk_cost );
+  }
+
+}
@@ -0,0 +1,42 @@
+#ifndef __SHARD_PLANNER__
+#define __SHARD_PLANNER__
+
+#include <vector>
+#include "FileManagerTypes.h"
+
+namespace larlitecv {
+
+  class FileManager;
+  class EventCostTable;
+
+  // Splits an index into shards that never cut through a file block,
+  // so that independent jobs each open only the files of their own shard.
+  class ShardPlanner {
+
+  public:
+
+    ShardPlanner() {};
+    virtual ~ShardPlanner() {};
+
+    /// split the blocks into nshards contiguous groups of similar total weight. returns the block indices of shard ishard.
+    static std::vector<int> plan( const std::vector<double>& block_weights, int ishard, int nshards );
+
+    /// weights from the number of entries in each block
+    static std::vector<double> entry_weights( const std::vector<FileBlock>& blocks );
+
+    /// cut entries [start,end) into chunks of at most chunk_size entries that never cross a file block
+    static std::vector<EntryRange> make_chunks( const std::vector<FileBlock>& blocks, Entry_t start, Entry_t end, int chunk_size );
+
+    /// as above, but a chunk is closed once its entries add up to chunk_cost
+    static std::vector<EntryRange> make_chunks( const std::vector<FileBlock>& blocks, Entry_t start, Entry_t end,
+						const std::vector<double>& entry_costs, double chunk_cost );
+
+    /// chunks of fman's entries [start,end) worth about chunk_size average entries of processing time.
+    /// plain entry counting if costs is empty.
+    static std::vector<EntryRange> make_chunks( const FileManager& fman, const EventCostTable& costs, Entry_t start, Entry_t end, int chunk_size );
+
+  };
+
+}
+
+#endif
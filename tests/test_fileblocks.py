@@ -0,0 +1,34 @@
+import os,sys
+
+import ROOT
+from larlitecv import larlitecv
+
+# four file blocks of 2^30 events each: the offsets of the last blocks pass INT32_MAX.
+# the RSE lists are run-length encoded, so each block is a single range and no files are needed.
+blocksize = 1<<30
+nblocks = 4
+
+entry2rse = larlitecv.RSElist()
+blocks = ROOT.std.vector(larlitecv.FileBlock)()
+for iblock in range(nblocks):
+    r = larlitecv.RSERange( larlitecv.RSE(iblock+1,0,0), 0 )
+    r.nentries = blocksize
+    ranges = ROOT.std.vector(larlitecv.RSERange)()
+    ranges.push_back( r )
+    rselist = larlitecv.RSElist()
+    rselist.set_ranges( ranges )
+    larlitecv.FileManager.append_block( rselist, 2*iblock, 2, entry2rse, blocks )
+
+assert blocks.size()==nblocks
+for iblock in range(nblocks):
+    block = blocks.at(iblock)
+    print "block ",iblock,": first_entry=",block.first_entry," nentries=",block.nentries," first_file=",block.first_file
+    assert block.first_entry==iblock*blocksize
+    assert block.nentries==blocksize
+    assert block.first_file==2*iblock and block.nfiles==2
+assert blocks.at(nblocks-1).first_entry>2**31-1
+assert entry2rse.size()==nblocks*blocksize
+
+rse = entry2rse.at( 3*blocksize+5 )
+assert rse.run==4 and rse.subrun==0 and rse.event==5
+print "file blocks past INT32_MAX: ok"